@@ -924,6 +924,8 @@ class GraphicalVulkanEditor(QMainWindow):
             parameters.append(view.vertexShaderEntryFunctionNameInput.text())
             parameters.append(view.fragmentShaderFileInput.text())
             parameters.append(view.fragmentShaderEntryFunctionNameInput.text())
+            parameters.append(view.vertexShaderDefinesInput.text())
+            parameters.append(view.fragmentShaderDefinesInput.text())
 
             return parameters
 
@@ -990,6 +992,8 @@ class GraphicalVulkanEditor(QMainWindow):
                 parameters.append(view.vertexShaderEntryFunctionNameInput.text())
                 parameters.append(view.fragmentShaderFileInput.text())
                 parameters.append(view.fragmentShaderEntryFunctionNameInput.text())
+                parameters.append(view.vertexShaderDefinesInput.text())
+                parameters.append(view.fragmentShaderDefinesInput.text())
 
                 return parameters
 
@@ -1041,6 +1045,8 @@ class GraphicalVulkanEditor(QMainWindow):
             view.vertexShaderEntryFunctionNameInput.setText(pipelineData[40])
             view.fragmentShaderFileInput.setText(pipelineData[41])
             view.fragmentShaderEntryFunctionNameInput.setText(pipelineData[42])
+            view.vertexShaderDefinesInput.setText(pipelineData[43])
+            view.fragmentShaderDefinesInput.setText(pipelineData[44])
 
             view.addPipelineOKButton.accepted.connect(editPipeline)
             view.setWindowTitle("Edit Graphics Pipeline")
@@ -1345,7 +1351,8 @@ class GraphicalVulkanEditor(QMainWindow):
                 'attachmentCountInput', 'blendConstant0Input', 'blendConstant1Input',
                 'blendConstant2Input', 'blendConstant3Input', 'vertexShaderFileInput',
                 'vertexShaderEntryFunctionNameInput', 'fragmentShaderFileInput',
-                'fragmentShaderEntryFunctionNameInput'
+                'fragmentShaderEntryFunctionNameInput', 'vertexShaderDefinesInput',
+                'fragmentShaderDefinesInput'
             ]
 
             for index, value in enumerate(data):
@@ -1461,10 +1468,13 @@ class GraphicalVulkanEditor(QMainWindow):
                 for child in elem:
                     if child.tag in {"vertexShaderFileInput", "vertexShaderEntryFunctionNameInput",
                                      "fragmentShaderFileInput",
-                                     "fragmentShaderEntryFunctionNameInput"} and child.text is None:
+                                     "fragmentShaderEntryFunctionNameInput", "vertexShaderDefinesInput",
+                                     "fragmentShaderDefinesInput"} and child.text is None:
                         pipeline.append("")
                     else:
                         pipeline.append(child.text.strip())
+                # savestates without shader defines use the default permutation
+                pipeline += [""] * (45 - len(pipeline))
 
                 pipelineItem = QListWidgetItem(pipelineName)
                 pipelineItem.setData(Qt.UserRole, pipeline)
@@ -1524,7 +1534,7 @@ class GraphicalVulkanEditor(QMainWindow):
                 return "VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT"
 
         def appendFixedFunctionParameters(pipelineName: str, pipeline: list):
-            params = f'''FixedFunctionStageParameters {pipelineName}{{
+            params = f'''inline constexpr FixedFunctionStageParameters {pipelineName}{{
 			//////////////////////// INPUT ASSEMBLY
 			{pipeline[0]}, // inputAssemblyInfo_topology
 			{pipeline[1]}, // inputAssemblyInfo_primitiveRestartEnable
@@ -1579,11 +1589,13 @@ class GraphicalVulkanEditor(QMainWindow):
             return params
 
         def appendShaderStageParameters(pipelineName: str, pipeline: list):
-            shaders = f'''ShaderStageParameters {pipelineName + "_shaders"}{{
+            shaders = f'''inline constexpr ShaderStageParameters {pipelineName + "_shaders"}{{
 			 "{pipeline[39]}", // vertexShaderText
 			 "{pipeline[41]}", // fragmentShaderText
 			 "{pipeline[40]}", // vertexShaderEntryFunctionName
-			 "{pipeline[42]}" // fragmentShaderEntryFunctionName
+			 "{pipeline[42]}", // fragmentShaderEntryFunctionName
+			 "{pipeline[43]}", // vertexShaderDefines
+			 "{pipeline[44]}" // fragmentShaderDefines
 		}};
         '''
             return shaders
@@ -1621,6 +1633,7 @@ class GraphicalVulkanEditor(QMainWindow):
         headerContent = f'''// This header includes all changeable but constant variables for the VulkanProject Header.
 // Any changes should be made inside this header-file such that the original implementation can be kept untouched.
 // DO NOT TOUCH THIS FILE. Any changes will be overridden on next save of Graphical Vulkan Editor.
+// All values are constexpr, such that the configuration is resolved at compile time without any static initialization.
 
 
 #pragma once
@@ -1628,42 +1641,42 @@ class GraphicalVulkanEditor(QMainWindow):
 namespace GVEProject {{
 
 	// Instance
-	const char* APPLICATION_NAME = "{self.applicationNameInput.text()}";
-	const bool SHOW_VALIDATION_LAYER_DEBUG_INFO = {self.convertToVulkanNaming(self.showValidationLayerDebugInfoCheckBox.isChecked())};
-	const bool RUN_ON_MACOS = {self.convertToVulkanNaming(self.runOnMacosCheckBox.isChecked())};
+	inline constexpr const char* APPLICATION_NAME = "{self.applicationNameInput.text()}";
+	inline constexpr bool SHOW_VALIDATION_LAYER_DEBUG_INFO = {self.convertToVulkanNaming(self.showValidationLayerDebugInfoCheckBox.isChecked())};
+	inline constexpr bool RUN_ON_MACOS = {self.convertToVulkanNaming(self.runOnMacosCheckBox.isChecked())};
 
 	// Physical Device
-	const bool CHOOSE_GPU_ON_STARTUP = {self.convertToVulkanNaming(self.chooseGPUOnStartupCheckBox.isChecked())};
+	inline constexpr bool CHOOSE_GPU_ON_STARTUP = {self.convertToVulkanNaming(self.chooseGPUOnStartupCheckBox.isChecked())};
 
 	// Device
 
-	const std::vector<const char*> DEVICE_EXTENSIONS {{\n\t {
+	inline constexpr std::array<const char*, {len(self.getListContents(self.deviceExtensionsList))}> DEVICE_EXTENSIONS {{\n\t {
         ','.join(self.getListContents(self.deviceExtensionsList)[::-1])
 	}\n\t}};
 
 	// Swapchain
-	const uint32_t WIDTH = {self.imageHeightInput.text()};
-	const uint32_t HEIGHT = {self.imageWidthInput.text()};
-	VkClearColorValue CLEAR_COLOR = {{ {{{self.clearColorRInput.text().replace(",", ".")}f, {self.clearColorGInput.text().replace(",", ".")}f, {self.clearColorBInput.text().replace(",", ".")}f, {self.clearColorAInput.text().replace(",", ".")}f}} }};
-	const int MAX_FRAMES_IN_FLIGHT = {self.framesInFlightInput.text()};
-	const bool LOCK_WINDOW_SIZE = {self.convertToVulkanNaming(self.lockWindowSizeCheckBox.isChecked())};
-	const VkImageUsageFlagBits IMAGE_USAGE = {self.imageUsageInput.currentText()};
-	const VkPresentModeKHR PRESENTATION_MODE = {self.presentationModeInput.currentText()};
-	const bool SAVE_ENERGY_FOR_MOBILE = {self.convertToVulkanNaming(self.saveEnergyForMobileCheckBox.isChecked())};
-	const VkFormat IMAGE_FORMAT = {self.imageFormatInput.currentText()};
-	const VkColorSpaceKHR IMAGE_COLOR_SPACE = {self.imageColorSpaceInput.currentText()};
+	inline constexpr uint32_t WIDTH = {self.imageHeightInput.text()};
+	inline constexpr uint32_t HEIGHT = {self.imageWidthInput.text()};
+	inline constexpr VkClearColorValue CLEAR_COLOR = {{ {{{self.clearColorRInput.text().replace(",", ".")}f, {self.clearColorGInput.text().replace(",", ".")}f, {self.clearColorBInput.text().replace(",", ".")}f, {self.clearColorAInput.text().replace(",", ".")}f}} }};
+	inline constexpr int MAX_FRAMES_IN_FLIGHT = {self.framesInFlightInput.text()};
+	inline constexpr bool LOCK_WINDOW_SIZE = {self.convertToVulkanNaming(self.lockWindowSizeCheckBox.isChecked())};
+	inline constexpr VkImageUsageFlagBits IMAGE_USAGE = {self.imageUsageInput.currentText()};
+	inline constexpr VkPresentModeKHR PRESENTATION_MODE = {self.presentationModeInput.currentText()};
+	inline constexpr bool SAVE_ENERGY_FOR_MOBILE = {self.convertToVulkanNaming(self.saveEnergyForMobileCheckBox.isChecked())};
+	inline constexpr VkFormat IMAGE_FORMAT = {self.imageFormatInput.currentText()};
+	inline constexpr VkColorSpaceKHR IMAGE_COLOR_SPACE = {self.imageColorSpaceInput.currentText()};
 	
 	// Descriptor
 
 	// Shader
 
 	// Model
-	const std::string MODEL_FILE = "{self.modelFileInput.text()}";
-	const std::string TEXTURE_FILE = "{self.textureFileInput.text()}";
+	inline constexpr const char* MODEL_FILE = "{self.modelFileInput.text()}";
+	inline constexpr const char* TEXTURE_FILE = "{self.textureFileInput.text()}";
 
 	// Graphics Pipeline
-    const bool USE_INDEXED_VERTICES = {self.convertToVulkanNaming(self.useIndexedVerticesCheckBox.isChecked())};
-	const bool REDUCE_SPIRV_CODE_SIZE = {self.convertToVulkanNaming(self.reduceSpirvCodeSizeCheckBox.isChecked())};
+    inline constexpr bool USE_INDEXED_VERTICES = {self.convertToVulkanNaming(self.useIndexedVerticesCheckBox.isChecked())};
+	inline constexpr bool REDUCE_SPIRV_CODE_SIZE = {self.convertToVulkanNaming(self.reduceSpirvCodeSizeCheckBox.isChecked())};
 
 		// Pipeline
 		struct FixedFunctionStageParameters {{
@@ -1719,10 +1732,12 @@ namespace GVEProject {{
 			const float colorBlendingInfo_blendConstants_3; // Optional
 		}};
 		struct ShaderStageParameters {{
-			const std::string vertexShaderText;
-			const std::string fragmentShaderText;
+			const char* vertexShaderText;
+			const char* fragmentShaderText;
 			const char* vertexShaderEntryFunctionName; // choose entry point function within vertex shader
 			const char* fragmentShaderEntryFunctionName; // choose entry point function within fragment shader
+			const char* vertexShaderDefines; // semicolon separated preprocessor defines selecting the shader permutation, e.g. "DEBUG_UV;SCALE=2"
+			const char* fragmentShaderDefines; // semicolon separated preprocessor defines selecting the shader permutation, e.g. "DEBUG_UV;SCALE=2"
 		}};
 		
 		// Functional Parameters 
@@ -1730,16 +1745,16 @@ namespace GVEProject {{
 		// Shader Parameters
 		{shaderCode}
 
-		const std::vector<FixedFunctionStageParameters> PIPELINE_PARAMETERS{{ {','.join(pipelineNames)} }};
+		inline constexpr std::array<FixedFunctionStageParameters, {len(pipelineNames)}> PIPELINE_PARAMETERS{{ {','.join(pipelineNames)} }};
 
-		const std::vector<ShaderStageParameters> PIPELINE_SHADERS{{ {', '.join(shaderNames)} }};
+		inline constexpr std::array<ShaderStageParameters, {len(shaderNames)}> PIPELINE_SHADERS{{ {', '.join(shaderNames)} }};
 
-		const int PIPELINE_COUNT = PIPELINE_PARAMETERS.size();
+		inline constexpr int PIPELINE_COUNT = static_cast<int>(PIPELINE_PARAMETERS.size());
 
 
 	// To be implemented
-	const bool MIPMAP_LEVEL = 0;
-	const VkBool32 ENABLE_ANISOTRIPIC_FILTER = VK_TRUE;
+	inline constexpr bool MIPMAP_LEVEL = 0;
+	inline constexpr VkBool32 ENABLE_ANISOTRIPIC_FILTER = VK_TRUE;
 
 }}
         '''
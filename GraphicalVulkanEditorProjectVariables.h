@@ -1,6 +1,7 @@
 // This header includes all changeable but constant variables for the VulkanProject Header.
 // Any changes should be made inside this header-file such that the original implementation can be kept untouched.
 // DO NOT TOUCH THIS FILE. Any changes will be overridden on next save of Graphical Vulkan Editor.
+// All values are constexpr, such that the configuration is resolved at compile time without any static initialization.
 
 
 #pragma once
@@ -8,42 +9,45 @@
 namespace GVEProject {
 
 	// Instance
-	const char* APPLICATION_NAME = "Vulkan Application";
-	const bool SHOW_VALIDATION_LAYER_DEBUG_INFO = VK_TRUE;
-	const bool RUN_ON_MACOS = VK_FALSE;
+	inline constexpr const char* APPLICATION_NAME = "Vulkan Application";
+	inline constexpr bool SHOW_VALIDATION_LAYER_DEBUG_INFO = VK_TRUE;
+	inline constexpr bool RUN_ON_MACOS = VK_FALSE;
 
 	// Physical Device
-	const bool CHOOSE_GPU_ON_STARTUP = VK_FALSE;
+	inline constexpr bool CHOOSE_GPU_ON_STARTUP = VK_FALSE;
 
 	// Device
 
-	const std::vector<const char*> DEVICE_EXTENSIONS {
+	inline constexpr std::array<const char*, 1> DEVICE_EXTENSIONS {
 	 VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
 
 	// Swapchain
-	const uint32_t WIDTH = 800;
-	const uint32_t HEIGHT = 800;
-	VkClearColorValue CLEAR_COLOR = { {0.00f, 0.00f, 0.00f, 1.00f} };
-	const int MAX_FRAMES_IN_FLIGHT = 2;
-	const bool LOCK_WINDOW_SIZE = VK_FALSE;
-	const VkImageUsageFlagBits IMAGE_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	const VkPresentModeKHR PRESENTATION_MODE = VK_PRESENT_MODE_MAILBOX_KHR;
-	const bool SAVE_ENERGY_FOR_MOBILE = VK_FALSE;
-	const VkFormat IMAGE_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
-	const VkColorSpaceKHR IMAGE_COLOR_SPACE = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
+	inline constexpr uint32_t WIDTH = 800;
+	inline constexpr uint32_t HEIGHT = 800;
+	inline constexpr VkClearColorValue CLEAR_COLOR = { {0.00f, 0.00f, 0.00f, 1.00f} };
+	inline constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+	inline constexpr bool LOCK_WINDOW_SIZE = VK_FALSE;
+	inline constexpr VkImageUsageFlagBits IMAGE_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	inline constexpr VkPresentModeKHR PRESENTATION_MODE = VK_PRESENT_MODE_MAILBOX_KHR;
+	inline constexpr bool SAVE_ENERGY_FOR_MOBILE = VK_FALSE;
+	inline constexpr VkFormat IMAGE_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+	inline constexpr VkColorSpaceKHR IMAGE_COLOR_SPACE = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
 	
 	// Descriptor
 
 	// Shader
+	inline constexpr const char* CULLING_COMPUTE_SHADER = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/cull.comp"; // computeShaderText
+	inline constexpr const char* DEPTH_PYRAMID_COMPUTE_SHADER = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/depth_pyramid.comp"; // computeShaderText
+	inline constexpr const char* DEPTH_PREPASS_VERTEX_SHADER = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/depth_prepass.vert"; // vertexShaderText
 
 	// Model
-	const std::string MODEL_FILE = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/models/viking_room.obj";
-	const std::string TEXTURE_FILE = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/textures/viking_room.png";
+	inline constexpr const char* MODEL_FILE = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/models/viking_room.obj";
+	inline constexpr const char* TEXTURE_FILE = "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/textures/viking_room.png";
 
 	// Graphics Pipeline
-    const bool USE_INDEXED_VERTICES = VK_TRUE;
-	const bool REDUCE_SPIRV_CODE_SIZE = VK_FALSE;
+    inline constexpr bool USE_INDEXED_VERTICES = VK_TRUE;
+	inline constexpr bool REDUCE_SPIRV_CODE_SIZE = VK_FALSE;
 
 		// Pipeline
 		struct FixedFunctionStageParameters {
@@ -99,14 +103,16 @@ namespace GVEProject {
 			const float colorBlendingInfo_blendConstants_3; // Optional
 		};
 		struct ShaderStageParameters {
-			const std::string vertexShaderText;
-			const std::string fragmentShaderText;
+			const char* vertexShaderText;
+			const char* fragmentShaderText;
 			const char* vertexShaderEntryFunctionName; // choose entry point function within vertex shader
 			const char* fragmentShaderEntryFunctionName; // choose entry point function within fragment shader
+			const char* vertexShaderDefines; // semicolon separated preprocessor defines selecting the shader permutation, e.g. "DEBUG_UV;SCALE=2"
+			const char* fragmentShaderDefines; // semicolon separated preprocessor defines selecting the shader permutation, e.g. "DEBUG_UV;SCALE=2"
 		};
 		
 		// Functional Parameters 
-		FixedFunctionStageParameters graphics_pipeline_1{
+		inline constexpr FixedFunctionStageParameters graphics_pipeline_1{
 			//////////////////////// INPUT ASSEMBLY
 			VK_PRIMITIVE_TOPOLOGY_POINT_LIST, // inputAssemblyInfo_topology
 			VK_FALSE, // inputAssemblyInfo_primitiveRestartEnable
@@ -158,7 +164,7 @@ namespace GVEProject {
 			0.00f // colorBlendingInfo_blendConstants_3
 		};
 
-        FixedFunctionStageParameters graphics_pipeline_2{
+        inline constexpr FixedFunctionStageParameters graphics_pipeline_2{
 			//////////////////////// INPUT ASSEMBLY
 			VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, // inputAssemblyInfo_topology
 			VK_FALSE, // inputAssemblyInfo_primitiveRestartEnable
@@ -212,30 +218,34 @@ namespace GVEProject {
 
         
 		// Shader Parameters
-		ShaderStageParameters graphics_pipeline_1_shaders{
+		inline constexpr ShaderStageParameters graphics_pipeline_1_shaders{
 			 "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/shader.vert", // vertexShaderText
 			 "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/shader.frag", // fragmentShaderText
 			 "main", // vertexShaderEntryFunctionName
-			 "main" // fragmentShaderEntryFunctionName
+			 "main", // fragmentShaderEntryFunctionName
+			 "", // vertexShaderDefines
+			 "" // fragmentShaderDefines
 		};
-        ShaderStageParameters graphics_pipeline_2_shaders{
+        inline constexpr ShaderStageParameters graphics_pipeline_2_shaders{
 			 "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/shader.vert", // vertexShaderText
-			 "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/shader-debug.frag", // fragmentShaderText
+			 "C:/Users/Avoccardo/Documents/GitHub/GraphicalVulkanEditor/resources/shaders/raw_shaders/shader.frag", // fragmentShaderText
 			 "main", // vertexShaderEntryFunctionName
-			 "main" // fragmentShaderEntryFunctionName
+			 "main", // fragmentShaderEntryFunctionName
+			 "", // vertexShaderDefines
+			 "DEBUG_UV" // fragmentShaderDefines
 		};
         
 
-		const std::vector<FixedFunctionStageParameters> PIPELINE_PARAMETERS{ graphics_pipeline_1,graphics_pipeline_2 };
+		inline constexpr std::array<FixedFunctionStageParameters, 2> PIPELINE_PARAMETERS{ graphics_pipeline_1,graphics_pipeline_2 };
 
-		const std::vector<ShaderStageParameters> PIPELINE_SHADERS{ graphics_pipeline_1_shaders, graphics_pipeline_2_shaders };
+		inline constexpr std::array<ShaderStageParameters, 2> PIPELINE_SHADERS{ graphics_pipeline_1_shaders, graphics_pipeline_2_shaders };
 
-		const int PIPELINE_COUNT = PIPELINE_PARAMETERS.size();
+		inline constexpr int PIPELINE_COUNT = static_cast<int>(PIPELINE_PARAMETERS.size());
 
 
 	// To be implemented
-	const bool MIPMAP_LEVEL = 0;
-	const VkBool32 ENABLE_ANISOTRIPIC_FILTER = VK_TRUE;
+	inline constexpr bool MIPMAP_LEVEL = 0;
+	inline constexpr VkBool32 ENABLE_ANISOTRIPIC_FILTER = VK_TRUE;
 
 }
         
\ No newline at end of file
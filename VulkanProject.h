@@ -46,13 +46,19 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+// GVE_EMBEDDED_SHADERS: use the SPIR-V embedded by the pre-build step resources/shaders/embed_shaders.py instead of compiling shader files at runtime with shaderc
+#ifdef GVE_EMBEDDED_SHADERS
+#include "EmbeddedShaders.h"
+#else
 #include <shaderc/shaderc.hpp>
+#endif
 
 #include <iostream>
 #include <cstdlib>
 #include <stdexcept>
 #include <vector>
 #include <map>
+#include <deque>
 #include <unordered_map>
 #include <set>
 #include <optional>
@@ -61,51 +67,1542 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <sstream>
+#include <string_view>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <filesystem>
+
+// SIMD instruction set of the CPU frustum culling, see SphereCuller. AVX requires building with /arch:AVX (-mavx), scalar code without any of them
+#if defined(__AVX__)
+#include <immintrin.h>
+#define GVE_CULLING_AVX
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GVE_CULLING_SSE
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GVE_CULLING_NEON
+#endif
+
+#include "GraphicalVulkanEditorProjectVariables.h"
+
+
+#ifdef NDEBUG
+const bool enableValidationLayers = false;
+#else
+const bool enableValidationLayers = true;
+#endif
+
+const std::vector<const char*> validationLayers = {
+    "VK_LAYER_KHRONOS_validation"
+};
+
+const std::vector<const char*> deviceExtensions(GVEProject::DEVICE_EXTENSIONS.begin(), GVEProject::DEVICE_EXTENSIONS.end());
+
+// Print the time needed to create all pipelines monolithically and from pipeline libraries on startup.
+// Run with the lavapipe ICD (VK_ICD_FILENAMES=.../lvp_icd.x86_64.json) to compare both paths independent of the GPU driver.
+const bool benchmarkPipelineCreation = false;
+
+// Print device memory usage versus budget of every heap with the breakdown by resource category on startup and every few seconds.
+const bool printMemoryBudget = false;
+
+// Print the blocks, allocations and fragmentation of every device memory pool in use on startup.
+const bool printMemoryStatistics = false;
+
+// Copies of the model drawn on a grid around the origin, each with its own model matrix in the per-object uniform data.
+const uint32_t sceneObjectCount = 1;
+
+// Deliver the per-object data with vkCmdPushConstants for every draw instead of dynamic offsets into the uniform buffer.
+const bool usePushConstants = true;
+
+// Print the time needed to record draws with per-object data from push constants and from the dynamic uniform buffer on startup.
+const bool benchmarkPerObjectData = false;
+
+// Draw all scene objects of a pipeline entry with a single instanced draw, taking their object data from a per-instance vertex buffer.
+const bool useInstancing = false;
+
+// Draw every pipeline entry with 1, 10, ... up to a million instances, each count for about three seconds, and print the recording and GPU time.
+const bool benchmarkInstancing = false;
+
+// Cull the scene objects against the view frustum on the GPU: a compute shader appends an indirect draw for every visible object,
+// drawn with vkCmdDrawIndexedIndirectCount. Without drawIndirectCount (Vulkan 1.2 or VK_KHR_draw_indirect_count) the CPU packs the visible objects into one instanced indirect draw.
+const bool useGpuCulling = false;
+
+// Also skip objects hidden behind the depth of the previous frame in the culling shader of useGpuCulling (hierarchical-Z occlusion culling).
+// The depth attachment is stored and reduced into a depth pyramid after every frame, requires drawIndirectCount.
+const bool useOcclusionCulling = false;
+
+// Alternate occlusion culling off and on for about three seconds at a time, three times each, and print the triangles submitted per frame, counted by pipeline statistics queries.
+const bool benchmarkOcclusionCulling = false;
+
+// Instanced and culled draws read the object data from the instance buffer instead of push constants or the uniform buffer.
+const bool objectDataInInstanceBuffer = useInstancing || useGpuCulling;
+
+// Cull the scene objects against the view frustum on the CPU with SIMD and only record the draws of the visible objects.
+// Recorded command buffers are invalidated whenever the visible objects change.
+const bool useCpuCulling = false;
+
+// Print the number of bounding spheres culled per microsecond with SIMD and with scalar code on startup.
+const bool benchmarkCpuCulling = false;
+
+// Draw the depth of the scene first in a depth-only subpass from a tightly packed position-only vertex buffer. The scene subpass then
+// tests with VK_COMPARE_OP_EQUAL without writing depth, so every pixel is shaded once. Applies to pipeline entries that test and write depth.
+const bool useDepthPrePass = false;
+
+// subpass of the render pass the scene pipelines are created for and drawn in
+const uint32_t sceneSubpass = useDepthPrePass ? 1 : 0;
+
+static_assert(!benchmarkInstancing || (useInstancing && !useGpuCulling), "benchmarkInstancing measures the instanced draws of useInstancing");
+static_assert(!useCpuCulling || !objectDataInInstanceBuffer, "useCpuCulling records a draw per visible object, instanced draws are culled by useGpuCulling");
+static_assert(!useGpuCulling || GVEProject::USE_INDEXED_VERTICES, "useGpuCulling writes indexed indirect draws");
+static_assert(!useOcclusionCulling || useGpuCulling, "useOcclusionCulling extends the culling shader of useGpuCulling");
+static_assert(!benchmarkOcclusionCulling || useOcclusionCulling, "benchmarkOcclusionCulling compares the draws of useOcclusionCulling");
+
+// pipeline entries drawn in the depth pre-pass of useDepthPrePass, the other entries are only drawn in the scene subpass
+inline bool hasDepthPrePass(const GVEProject::FixedFunctionStageParameters& pipelineParameters) {
+    return useDepthPrePass && pipelineParameters.depthStencilInfo_depthTestEnable && pipelineParameters.depthStencilInfo_depthWriteEnable;
+}
+
+// Threads recording the draws of a frame into secondary command buffers, each from its own command pool per frame in flight.
+// With a single thread the draws are recorded inline into the primary command buffer.
+const uint32_t recordingThreadCount = 1;
+
+// the pipeline statistics query of a frame is active in the primary command buffer, secondary command buffers would have to inherit it
+static_assert(!benchmarkOcclusionCulling || recordingThreadCount == 1, "benchmarkOcclusionCulling counts the triangles of draws recorded inline");
+
+// Print the time needed to record a growing number of draws with every thread count up to recordingThreadCount on startup.
+const bool benchmarkParallelRecording = false;
+
+// Record the command buffers once per frame in flight and swapchain image and submit them again every frame, until the swapchain,
+// the pipelines or the scene change. Only the uniform buffer contents are updated per frame.
+const bool cacheCommandBuffers = false;
+
+// Pushed object data would be baked into cached command buffers, so they take it from the uniform buffer.
+const bool objectDataInPushConstants = usePushConstants && !cacheCommandBuffers;
+
+// Minimize the latency from input to present: input is polled right before the uniform buffers are updated, frames wait for the
+// previous present with VK_KHR_present_wait if available and the frames in flight shrink to 1 while CPU and GPU time of a frame fit
+// into one display refresh. The measured latency is printed every few seconds.
+const bool lowLatencyMode = false;
+
+// Serve object scope host allocations of the driver from thread-local arenas instead of the global heap.
+const bool useHostAllocationArena = false;
+
+// Print the host memory the driver allocated per allocation scope on startup.
+const bool printHostAllocationStatistics = false;
+
+// Directory of the SPIR-V compiled at runtime, one file per shader permutation named after the hash of its source, type and defines.
+// Unchanged permutations are loaded from it instead of compiled again. Empty to always compile, unused with GVE_EMBEDDED_SHADERS.
+const char* const shaderCacheDirectory = "shader_cache";
+
+// Host memory the driver allocates through VkAllocationCallbacks, tracked per allocation scope. Object scope allocations may be
+// served from a thread-local arena to avoid contention on the global heap when several threads create objects or record commands.
+struct HostAllocationTracker {
+    static constexpr size_t ARENA_CHUNK_SIZE = size_t(1) << 20;
+    static constexpr size_t MAX_ARENA_ALLOCATION_SIZE = ARENA_CHUNK_SIZE / 16; // larger allocations go to the global heap
+    static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+    struct ScopeStatistics {
+        std::atomic<size_t> size{ 0 };
+        std::atomic<size_t> peakSize{ 0 };
+        std::atomic<size_t> allocationCount{ 0 }; // live allocations
+        std::atomic<size_t> totalAllocationCount{ 0 };
+    };
+
+    ScopeStatistics scopes[SCOPE_COUNT]; // indexed by VkSystemAllocationScope
+    std::atomic<size_t> internalSize{ 0 }; // allocated by the driver itself and only reported, e.g. executable memory
+    std::atomic<size_t> arenaAllocationCount{ 0 };
+    std::vector<std::pair<std::string, long long>> measurements; // host memory retained by the objects created during each measurement
+    bool useObjectArena;
+    VkAllocationCallbacks callbacks{ this, &allocationCallback, &reallocationCallback, &freeCallback, &internalAllocationCallback, &internalFreeCallback };
+
+    explicit HostAllocationTracker(bool useObjectArena) : useObjectArena(useObjectArena) {}
+
+    size_t totalSize() const {
+        size_t size = 0;
+        for (const ScopeStatistics& scope : scopes) {
+            size += scope.size;
+        }
+        return size;
+    }
+
+    // record the host memory retained by the objects created since totalSize returned sizeBefore, e.g. pipelines or command buffers
+    void addMeasurement(const char* objectName, size_t sizeBefore) {
+        measurements.emplace_back(objectName, static_cast<long long>(totalSize()) - static_cast<long long>(sizeBefore));
+    }
+
+    void printStatistics() {
+        const char* scopeNames[SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+
+        std::cout << "Host allocations of the driver" << (useObjectArena ? " (object scope from thread-local arenas, " + std::to_string(arenaAllocationCount) + " allocations)" : "") << ":" << std::endl;
+        for (uint32_t i = 0; i < SCOPE_COUNT; i++) {
+            std::cout << "  " << scopeNames[i] << " scope: " << scopes[i].size << " bytes in " << scopes[i].allocationCount << " allocations, peak "
+                << scopes[i].peakSize << " bytes, " << scopes[i].totalAllocationCount << " allocations in total" << std::endl;
+        }
+        std::cout << "  internal: " << internalSize << " bytes" << std::endl;
+        for (const auto& measurement : measurements) {
+            std::cout << "  " << measurement.first << ": " << measurement.second << " bytes" << std::endl;
+        }
+    }
+
+private:
+    // Bump allocated chunk, freed once all of its allocations are freed and its thread moved on to a new chunk
+    struct ArenaChunk {
+        std::atomic<size_t> references{ 1 }; // live allocations plus one held by the owning thread while it allocates from the chunk
+        size_t used = 0;
+        alignas(std::max_align_t) char data[ARENA_CHUNK_SIZE];
+    };
+
+    struct ThreadArena {
+        ArenaChunk* chunk = nullptr;
+
+        ~ThreadArena() {
+            if (chunk != nullptr) {
+                releaseChunk(chunk);
+            }
+        }
+    };
+
+    // stored directly in front of every returned pointer, pfnFree only passes the pointer
+    struct AllocationHeader {
+        void* base; // start of the heap allocation, unused for arena allocations
+        ArenaChunk* chunk; // nullptr for heap allocations
+        size_t size;
+        VkSystemAllocationScope scope;
+    };
+
+    static void releaseChunk(ArenaChunk* chunk) {
+        if (chunk->references.fetch_sub(1) == 1) {
+            delete chunk;
+        }
+    }
+
+    static void* VKAPI_CALL allocationCallback(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+        auto tracker = static_cast<HostAllocationTracker*>(pUserData);
+        alignment = std::max(alignment, alignof(AllocationHeader));
+        size_t totalSize = sizeof(AllocationHeader) + alignment - 1 + size;
+
+        char* base;
+        ArenaChunk* chunk = nullptr;
+        if (tracker->useObjectArena && allocationScope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT && totalSize <= MAX_ARENA_ALLOCATION_SIZE) {
+            thread_local ThreadArena arena;
+            // only the owning thread adds references, a chunk without live allocations can be reused from its start
+            if (arena.chunk != nullptr && arena.chunk->references == 1) {
+                arena.chunk->used = 0;
+            }
+            if (arena.chunk == nullptr || arena.chunk->used + totalSize > ARENA_CHUNK_SIZE) {
+                if (arena.chunk != nullptr) {
+                    releaseChunk(arena.chunk);
+                }
+                arena.chunk = new (std::nothrow) ArenaChunk; // default initialization, value initialization would zero the whole chunk
+                if (arena.chunk == nullptr) {
+                    return nullptr;
+                }
+            }
+            chunk = arena.chunk;
+            base = chunk->data + chunk->used;
+            chunk->used += totalSize;
+            chunk->references++;
+            tracker->arenaAllocationCount++;
+        }
+        else {
+            base = static_cast<char*>(std::malloc(totalSize));
+            if (base == nullptr) {
+                return nullptr;
+            }
+        }
+
+        uintptr_t address = (reinterpret_cast<uintptr_t>(base) + sizeof(AllocationHeader) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        AllocationHeader* header = reinterpret_cast<AllocationHeader*>(address) - 1;
+        header->base = base;
+        header->chunk = chunk;
+        header->size = size;
+        header->scope = allocationScope;
+
+        ScopeStatistics& scope = tracker->scopes[allocationScope];
+        size_t scopeSize = scope.size += size;
+        scope.allocationCount++;
+        scope.totalAllocationCount++;
+        size_t peakSize = scope.peakSize;
+        while (scopeSize > peakSize && !scope.peakSize.compare_exchange_weak(peakSize, scopeSize)) {}
+
+        return reinterpret_cast<void*>(address);
+    }
+
+    static void* VKAPI_CALL reallocationCallback(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+        if (pOriginal == nullptr) {
+            return allocationCallback(pUserData, size, alignment, allocationScope);
+        }
+        if (size == 0) {
+            freeCallback(pUserData, pOriginal);
+            return nullptr;
+        }
+
+        // the original allocation stays valid if the new one fails
+        void* memory = allocationCallback(pUserData, size, alignment, allocationScope);
+        if (memory != nullptr) {
+            memcpy(memory, pOriginal, std::min(size, (static_cast<AllocationHeader*>(pOriginal) - 1)->size));
+            freeCallback(pUserData, pOriginal);
+        }
+        return memory;
+    }
+
+    static void VKAPI_CALL freeCallback(void* pUserData, void* pMemory) {
+        if (pMemory == nullptr) {
+            return;
+        }
+
+        auto tracker = static_cast<HostAllocationTracker*>(pUserData);
+        AllocationHeader* header = static_cast<AllocationHeader*>(pMemory) - 1;
+        tracker->scopes[header->scope].size -= header->size;
+        tracker->scopes[header->scope].allocationCount--;
+
+        if (header->chunk != nullptr) {
+            releaseChunk(header->chunk);
+        }
+        else {
+            std::free(header->base);
+        }
+    }
+
+    static void VKAPI_CALL internalAllocationCallback(void* pUserData, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope /*allocationScope*/) {
+        static_cast<HostAllocationTracker*>(pUserData)->internalSize += size;
+    }
+
+    static void VKAPI_CALL internalFreeCallback(void* pUserData, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope /*allocationScope*/) {
+        static_cast<HostAllocationTracker*>(pUserData)->internalSize -= size;
+    }
+};
+
+inline HostAllocationTracker hostAllocationTracker(useHostAllocationArena);
+
+// passed to every vkCreate*, vkDestroy*, vkAllocateMemory and vkFreeMemory call, objects must be destroyed with the callbacks they were created with
+inline const VkAllocationCallbacks* const hostAllocator = &hostAllocationTracker.callbacks;
+
+// Optional device features, only used if the physical device supports them. Filled on logical device creation
+struct DeviceCapabilities {
+    bool graphicsPipelineLibrary = false; // VK_EXT_graphics_pipeline_library: pipelines are linked from separately compiled parts
+    bool extendedDynamicState = false; // VK_EXT_extended_dynamic_state: cull mode, front face, topology (within its class), depth and stencil test settings
+    bool extendedDynamicState2 = false; // VK_EXT_extended_dynamic_state2: depth bias enable, primitive restart, rasterizer discard
+    bool extendedDynamicState3PolygonMode = false; // VK_EXT_extended_dynamic_state3: polygon mode
+    bool extendedDynamicState3ColorBlend = false; // VK_EXT_extended_dynamic_state3: color blend enable, blend equation and color write mask
+    bool wideLines = false; // line widths other than 1.0, otherwise lines are drawn with a width of 1.0
+    bool memoryBudget = false; // VK_EXT_memory_budget: heap budgets and process usage reported by the driver, estimated from own allocations otherwise
+    bool dedicatedTransferQueue = false; // queue family with transfer but without graphics support (DMA engine), uploads run on the graphics queue otherwise
+    bool presentWait = false; // VK_KHR_present_id and VK_KHR_present_wait: wait until a present is visible, lowLatencyMode paces on GPU completion otherwise
+    bool drawIndirectCount = false; // drawIndirectCount of Vulkan 1.2 or VK_KHR_draw_indirect_count, and drawIndirectFirstInstance: useGpuCulling culls in a compute shader, on the CPU otherwise
+    bool pipelineStatisticsQuery = false; // benchmarkOcclusionCulling counts the submitted triangles with pipeline statistics queries
+    float timestampPeriod = 0.0f; // nanoseconds per timestamp tick, 0 if the graphics queue does not support timestamps
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT; // samples of the render pass attachments, the highest rasterizationSamples of the pipeline entries the device supports
+    uint32_t graphicsQueueFamily = 0;
+    uint32_t transferQueueFamily = 0; // equals graphicsQueueFamily without dedicated transfer queue
+
+    // extension commands are not exported by the loader, they are fetched with vkGetDeviceProcAddr for the enabled capabilities
+    PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT = nullptr;
+    PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT = nullptr;
+    PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT = nullptr;
+    PFN_vkCmdSetDepthBoundsTestEnableEXT vkCmdSetDepthBoundsTestEnableEXT = nullptr;
+    PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT = nullptr;
+    PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT = nullptr;
+    PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT = nullptr;
+    PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT = nullptr;
+    PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT = nullptr;
+    PFN_vkCmdSetColorBlendEnableEXT vkCmdSetColorBlendEnableEXT = nullptr;
+    PFN_vkCmdSetColorBlendEquationEXT vkCmdSetColorBlendEquationEXT = nullptr;
+    PFN_vkCmdSetColorWriteMaskEXT vkCmdSetColorWriteMaskEXT = nullptr;
+    PFN_vkWaitForPresentKHR vkWaitForPresentKHR = nullptr;
+    PFN_vkCmdDrawIndexedIndirectCount vkCmdDrawIndexedIndirectCount = nullptr; // core or VK_KHR_draw_indirect_count command, see drawIndirectCount
+};
+
+// Compiled parts of graphics pipelines (VK_EXT_graphics_pipeline_library), keyed by the state each part is built from.
+// Pipelines that only differ in e.g. rasterizer or blend settings share the other parts and only need to be linked.
+struct PipelineLibraryCache {
+    std::map<std::string, VkPipeline> vertexInputLibraries; // vertex input and input assembly
+    std::map<std::string, VkPipeline> preRasterizationLibraries; // vertex shader, viewport and rasterizer
+    std::map<std::string, VkPipeline> fragmentShaderLibraries; // fragment shader, depth stencil and multisampling
+    std::map<std::string, VkPipeline> fragmentOutputLibraries; // color blending and multisampling
+
+    void destroy(VkDevice device) {
+        for (auto libraries : { &vertexInputLibraries, &preRasterizationLibraries, &fragmentShaderLibraries, &fragmentOutputLibraries }) {
+            for (auto& library : *libraries) {
+                vkDestroyPipeline(device, library.second, hostAllocator);
+            }
+            libraries->clear();
+        }
+    }
+};
+
+// Resource categories device memory is accounted for, textures and meshes are streamed and throttled by the memory budget
+enum MemoryCategory {
+    MEMORY_CATEGORY_TEXTURES,
+    MEMORY_CATEGORY_MESHES,
+    MEMORY_CATEGORY_UNIFORMS,
+    MEMORY_CATEGORY_ATTACHMENTS,
+    MEMORY_CATEGORY_STAGING,
+    MEMORY_CATEGORY_COUNT
+};
+
+const char* const MEMORY_CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = { "textures", "meshes", "uniforms", "attachments", "staging" };
+
+// Sub-allocation of a resource within a memory block of the DeviceMemoryAllocator
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0; // offset to bind the resource at
+    VkDeviceSize size = 0; // size requested by the resource
+    void* mapped = nullptr; // persistently mapped address for host visible memory types, nullptr otherwise
+    uint32_t poolIndex = 0;
+    uint32_t blockIndex = 0;
+    uint32_t level = 0; // buddy level of the node within its block, DEDICATED_ALLOCATION for resources with their own VkDeviceMemory
+    MemoryCategory category = MEMORY_CATEGORY_TEXTURES;
+};
+
+// Block based device memory allocator. Resources are sub-allocated from large VkDeviceMemory blocks with a buddy free list
+// instead of calling vkAllocateMemory per resource, which is slow and limited by maxMemoryAllocationCount.
+// Buddy nodes are aligned to their power of two size, which covers the alignment of the memory requirements.
+struct DeviceMemoryAllocator {
+    static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+    static constexpr VkDeviceSize MAX_BLOCK_SIZE = VkDeviceSize(64) << 20;
+    static constexpr uint32_t DEDICATED_ALLOCATION = UINT32_MAX;
+    static constexpr double BUDGET_WARNING_THRESHOLD = 0.9; // warn once a heap uses this share of its budget
+    static constexpr double ESTIMATED_BUDGET_SHARE = 0.8; // share of a heap assumed to be available without VK_EXT_memory_budget
+
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE; // VK_NULL_HANDLE once the empty block was freed, its slot is reused by the next block of the pool
+        void* mapped = nullptr;
+        VkDeviceSize usedSize = 0; // bytes of all allocated nodes
+        VkDeviceSize requestedSize = 0; // bytes requested by the resources within the allocated nodes
+        uint32_t allocationCount = 0;
+        std::vector<std::set<VkDeviceSize>> freeNodes; // offsets of free nodes per level, level 0 is the whole block
+    };
+
+    // Size class of one memory type, linear resources and optimal tiled images use separate pools if bufferImageGranularity requires it
+    struct MemoryPool {
+        VkDeviceSize blockSize = 0;
+        std::vector<MemoryBlock> blocks;
+        uint32_t dedicatedAllocationCount = 0;
+        VkDeviceSize dedicatedSize = 0;
+    };
+
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize bufferImageGranularity = 1;
+    uint32_t maxMemoryAllocationCount = 0;
+    uint32_t deviceMemoryCount = 0; // live vkAllocateMemory allocations
+    std::vector<MemoryPool> pools; // two pools per memory type: linear resources at memoryTypeIndex * 2, optimal tiled images at memoryTypeIndex * 2 + 1
+
+    // per heap accounting, budget and usage are updated by updateBudget
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    bool memoryBudgetAvailable = false;
+    VkDeviceSize heapBudgets[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize heapUsages[VK_MAX_MEMORY_HEAPS] = {}; // usage of the whole process with VK_EXT_memory_budget, own allocations otherwise
+    VkDeviceSize heapAllocatedSizes[VK_MAX_MEMORY_HEAPS] = {}; // bytes of own VkDeviceMemory allocations
+    VkDeviceSize heapCategorySizes[VK_MAX_MEMORY_HEAPS][MEMORY_CATEGORY_COUNT] = {}; // bytes requested by the resources of each category
+    bool heapBudgetWarnings[VK_MAX_MEMORY_HEAPS] = {};
+
+    void init(VkPhysicalDevice physicalDevice, bool memoryBudget) {
+        this->physicalDevice = physicalDevice;
+        memoryBudgetAvailable = memoryBudget;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        bufferImageGranularity = properties.limits.bufferImageGranularity;
+        maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+        pools.resize(memoryProperties.memoryTypeCount * 2);
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            // small heaps (e.g. the 256 MiB host visible device local heap) get smaller blocks so one block does not exhaust them
+            VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+            VkDeviceSize blockSize = MAX_BLOCK_SIZE;
+            while (blockSize > MIN_NODE_SIZE && blockSize > heapSize / 8) {
+                blockSize >>= 1;
+            }
+            pools[i * 2].blockSize = blockSize;
+            pools[i * 2 + 1].blockSize = blockSize;
+        }
+        updateBudget();
+    }
+
+    // the budget changes with the memory use of other processes, query it before allocating device memory and when reporting
+    void updateBudget() {
+        if (memoryBudgetAvailable) {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+            budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+            VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+            memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            memoryProperties2.pNext = &budgetProperties;
+            vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+            for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+                heapBudgets[heap] = budgetProperties.heapBudget[heap];
+                heapUsages[heap] = budgetProperties.heapUsage[heap];
+            }
+            return;
+        }
+
+        for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+            heapBudgets[heap] = static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[heap].size * ESTIMATED_BUDGET_SHARE);
+            heapUsages[heap] = heapAllocatedSizes[heap];
+        }
+    }
+
+    // streaming should only load further textures or meshes into the memory type if this holds
+    bool isWithinBudget(VkDeviceSize size, uint32_t memoryTypeIndex) const {
+        uint32_t heap = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        return heapUsages[heap] + size <= heapBudgets[heap];
+    }
+
+    MemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, bool optimalTiling, MemoryCategory category, VkDevice device) {
+        // nodes are aligned to their size, so linear and optimal resources may only share blocks if no node is smaller than the granularity
+        bool separateOptimalTiling = bufferImageGranularity > MIN_NODE_SIZE;
+
+        // streamed resources are throttled before the heap runs out: instead of allocating new device memory beyond the budget an empty allocation
+        // (memory is VK_NULL_HANDLE) is returned, so the caller can skip the resource or retry later and the application keeps running with the resources it has
+        uint32_t heap = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        bool throttled = category == MEMORY_CATEGORY_TEXTURES || category == MEMORY_CATEGORY_MESHES;
+
+        MemoryAllocation allocation{};
+        allocation.size = memoryRequirements.size;
+        allocation.category = category;
+        allocation.poolIndex = memoryTypeIndex * 2 + (optimalTiling && separateOptimalTiling ? 1 : 0);
+        MemoryPool& pool = pools[allocation.poolIndex];
+
+        VkDeviceSize nodeSize = MIN_NODE_SIZE;
+        while (nodeSize < memoryRequirements.size || nodeSize < memoryRequirements.alignment) {
+            nodeSize <<= 1;
+        }
+
+        if (nodeSize > pool.blockSize) {
+            if (throttled && !isWithinBudget(memoryRequirements.size, memoryTypeIndex)) {
+                return MemoryAllocation{};
+            }
+            heapCategorySizes[heap][category] += memoryRequirements.size;
+            allocation.level = DEDICATED_ALLOCATION;
+            allocation.memory = allocateDeviceMemory(memoryRequirements.size, memoryTypeIndex, &allocation.mapped, device);
+            pool.dedicatedAllocationCount++;
+            pool.dedicatedSize += memoryRequirements.size;
+            return allocation;
+        }
+
+        allocation.level = 0;
+        while ((pool.blockSize >> allocation.level) > nodeSize) {
+            allocation.level++;
+        }
+
+        for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+            if (pool.blocks[i].memory != VK_NULL_HANDLE && allocateNode(pool.blocks[i], pool.blockSize, allocation.level, &allocation.offset)) {
+                heapCategorySizes[heap][category] += memoryRequirements.size;
+                allocation.blockIndex = i;
+                return bindNode(pool.blocks[i], nodeSize, allocation);
+            }
+        }
+
+        if (throttled && !isWithinBudget(pool.blockSize, memoryTypeIndex)) {
+            return MemoryAllocation{};
+        }
+        heapCategorySizes[heap][category] += memoryRequirements.size;
+
+        MemoryBlock block{};
+        block.memory = allocateDeviceMemory(pool.blockSize, memoryTypeIndex, &block.mapped, device);
+        while ((pool.blockSize >> block.freeNodes.size()) >= MIN_NODE_SIZE) {
+            block.freeNodes.emplace_back();
+        }
+        block.freeNodes[0].insert(0);
+
+        // block indices of live allocations must stay valid, so freed blocks keep their slot
+        auto freedBlock = std::find_if(pool.blocks.begin(), pool.blocks.end(), [](const MemoryBlock& block) { return block.memory == VK_NULL_HANDLE; });
+        if (freedBlock != pool.blocks.end()) {
+            *freedBlock = std::move(block);
+            allocation.blockIndex = static_cast<uint32_t>(freedBlock - pool.blocks.begin());
+        }
+        else {
+            pool.blocks.push_back(std::move(block));
+            allocation.blockIndex = static_cast<uint32_t>(pool.blocks.size() - 1);
+        }
+        allocateNode(pool.blocks[allocation.blockIndex], pool.blockSize, allocation.level, &allocation.offset);
+        return bindNode(pool.blocks[allocation.blockIndex], nodeSize, allocation);
+    }
+
+    void free(MemoryAllocation& allocation, VkDevice device) {
+        if (allocation.memory == VK_NULL_HANDLE) {
+            return; // throttled or already freed
+        }
+        MemoryPool& pool = pools[allocation.poolIndex];
+        uint32_t heap = memoryProperties.memoryTypes[allocation.poolIndex / 2].heapIndex;
+        heapCategorySizes[heap][allocation.category] -= allocation.size;
+
+        if (allocation.level == DEDICATED_ALLOCATION) {
+            vkFreeMemory(device, allocation.memory, hostAllocator);
+            deviceMemoryCount--;
+            heapAllocatedSizes[heap] -= allocation.size;
+            pool.dedicatedAllocationCount--;
+            pool.dedicatedSize -= allocation.size;
+            allocation = MemoryAllocation{};
+            return;
+        }
+
+        MemoryBlock& block = pool.blocks[allocation.blockIndex];
+        block.usedSize -= pool.blockSize >> allocation.level;
+        block.requestedSize -= allocation.size;
+        block.allocationCount--;
+
+        // merge the node with its buddy as long as the buddy is free as well
+        VkDeviceSize offset = allocation.offset;
+        uint32_t level = allocation.level;
+        while (level > 0 && block.freeNodes[level].erase(offset ^ (pool.blockSize >> level)) > 0) {
+            offset &= ~(pool.blockSize >> level);
+            level--;
+        }
+        block.freeNodes[level].insert(offset);
+
+        // return empty blocks to the driver, but keep one spare block per pool so alternating allocations do not call vkAllocateMemory every time
+        if (block.allocationCount == 0) {
+            bool spareBlock = std::any_of(pool.blocks.begin(), pool.blocks.end(), [&block](const MemoryBlock& other) {
+                return &other != &block && other.memory != VK_NULL_HANDLE && other.allocationCount == 0;
+            });
+            if (spareBlock) {
+                vkFreeMemory(device, block.memory, hostAllocator); // implicitly unmaps the block
+                deviceMemoryCount--;
+                heapAllocatedSizes[heap] -= pool.blockSize;
+                if (!memoryBudgetAvailable) {
+                    heapUsages[heap] = heapAllocatedSizes[heap];
+                }
+                block = MemoryBlock{};
+            }
+        }
+
+        allocation = MemoryAllocation{};
+    }
+
+    // Print usage and fragmentation of all pools in use, external fragmentation is the share of free memory outside the largest free node
+    void printStatistics() {
+        std::cout << "Device memory allocations: " << deviceMemoryCount << " of at most " << maxMemoryAllocationCount << std::endl;
+
+        for (uint32_t i = 0; i < pools.size(); i++) {
+            const MemoryPool& pool = pools[i];
+            if (pool.blocks.empty() && pool.dedicatedAllocationCount == 0) {
+                continue;
+            }
+
+            uint32_t blockCount = 0, allocationCount = 0;
+            VkDeviceSize usedSize = 0, requestedSize = 0, freeSize = 0, largestFreeNode = 0;
+            for (const MemoryBlock& block : pool.blocks) {
+                blockCount += block.memory != VK_NULL_HANDLE ? 1 : 0;
+                allocationCount += block.allocationCount;
+                usedSize += block.usedSize;
+                requestedSize += block.requestedSize;
+                for (uint32_t level = 0; level < block.freeNodes.size(); level++) {
+                    if (!block.freeNodes[level].empty()) {
+                        freeSize += block.freeNodes[level].size() * (pool.blockSize >> level);
+                        largestFreeNode = std::max(largestFreeNode, pool.blockSize >> level);
+                    }
+                }
+            }
+            double externalFragmentation = freeSize > 0 ? 1.0 - static_cast<double>(largestFreeNode) / freeSize : 0.0;
+
+            std::cout << "  memory type " << i / 2 << (i % 2 == 0 ? " (linear)" : " (optimal)")
+                << ": " << blockCount << " blocks of " << pool.blockSize << " bytes, "
+                << allocationCount << " allocations using " << requestedSize << " bytes in nodes of " << usedSize << " bytes, "
+                << freeSize << " bytes free, largest free node " << largestFreeNode << " bytes, "
+                << "external fragmentation " << externalFragmentation * 100.0 << "%, "
+                << pool.dedicatedAllocationCount << " dedicated allocations of " << pool.dedicatedSize << " bytes" << std::endl;
+        }
+    }
+
+    // Print usage versus budget of every heap in use together with the share of each resource category
+    void printBudget() {
+        auto toMiB = [](VkDeviceSize size) { return static_cast<double>(size) / (1 << 20); };
+
+        std::cout << "Device memory budget" << (memoryBudgetAvailable ? "" : " (estimated, VK_EXT_memory_budget unavailable)") << ":" << std::endl;
+        for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+            if (heapAllocatedSizes[heap] == 0) {
+                continue;
+            }
+
+            std::cout << "  heap " << heap << ((memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : " (host)")
+                << ": " << toMiB(heapUsages[heap]) << " MiB used of " << toMiB(heapBudgets[heap]) << " MiB budget ("
+                << (heapBudgets[heap] > 0 ? 100.0 * heapUsages[heap] / heapBudgets[heap] : 0.0) << "%), "
+                << toMiB(heapAllocatedSizes[heap]) << " MiB allocated by the application:";
+            for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; category++) {
+                std::cout << " " << MEMORY_CATEGORY_NAMES[category] << " " << toMiB(heapCategorySizes[heap][category]) << " MiB";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    void destroy(VkDevice device) {
+        for (MemoryPool& pool : pools) {
+            for (MemoryBlock& block : pool.blocks) {
+                vkFreeMemory(device, block.memory, hostAllocator); // implicitly unmaps the block
+            }
+            pool.blocks.clear();
+        }
+        deviceMemoryCount = 0;
+        std::fill(std::begin(heapAllocatedSizes), std::end(heapAllocatedSizes), 0);
+    }
+
+private:
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped, VkDevice device) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        uint32_t heap = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        updateBudget();
+        if (heapUsages[heap] + size > heapBudgets[heap] * BUDGET_WARNING_THRESHOLD && !heapBudgetWarnings[heap]) {
+            std::cerr << "warning: memory heap " << heap << " is about to exceed " << BUDGET_WARNING_THRESHOLD * 100.0 << "% of its budget" << std::endl;
+            heapBudgetWarnings[heap] = true;
+        }
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &allocInfo, hostAllocator, &memory) != VK_SUCCESS) {
+            printBudget();
+            throw std::runtime_error("failed to allocate device memory block!");
+        }
+        deviceMemoryCount++;
+        heapAllocatedSizes[heap] += size;
+        if (!memoryBudgetAvailable) {
+            heapUsages[heap] = heapAllocatedSizes[heap];
+        }
+
+        // host visible memory stays mapped for its whole lifetime, it may only be mapped once
+        *mapped = nullptr;
+        if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+                throw std::runtime_error("failed to map device memory block!");
+            }
+        }
+
+        return memory;
+    }
+
+    // Take a free node of the given level, splitting larger free nodes if none is available
+    bool allocateNode(MemoryBlock& block, VkDeviceSize blockSize, uint32_t level, VkDeviceSize* offset) {
+        uint32_t freeLevel = level;
+        while (block.freeNodes[freeLevel].empty()) {
+            if (freeLevel == 0) {
+                return false;
+            }
+            freeLevel--;
+        }
+
+        *offset = *block.freeNodes[freeLevel].begin();
+        block.freeNodes[freeLevel].erase(block.freeNodes[freeLevel].begin());
+        // keep the lower half of each split and free its upper buddy
+        for (; freeLevel < level; freeLevel++) {
+            block.freeNodes[freeLevel + 1].insert(*offset + (blockSize >> (freeLevel + 1)));
+        }
+
+        return true;
+    }
+
+    MemoryAllocation bindNode(MemoryBlock& block, VkDeviceSize nodeSize, MemoryAllocation& allocation) {
+        allocation.memory = block.memory;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+        block.usedSize += nodeSize;
+        block.requestedSize += allocation.size;
+        block.allocationCount++;
+
+        return allocation;
+    }
+};
+
+// Timeline semaphore (VK_KHR_timeline_semaphore) signaled with a monotonically increasing value by every submission to the graphics
+// queue, frames and upload batches alike. Submissions complete in order, so a value being reached means the GPU finished the submission
+// that signaled it and everything submitted before. Anything that has to outlive GPU work waits for or checks the value of that work.
+struct GpuTimeline {
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0; // value signaled by the latest submission
+    uint64_t completedValue = 0; // last value known to be reached, avoids querying the semaphore again
+
+    // core in Vulkan 1.2 only, fetched with vkGetDeviceProcAddr under the core name or the name of VK_KHR_timeline_semaphore
+    PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
+
+    // value to signal with the next submission
+    uint64_t nextValue() {
+        return ++submittedValue;
+    }
+
+    bool isComplete(uint64_t value, VkDevice device) {
+        if (value > completedValue) {
+            vkGetSemaphoreCounterValueKHR(device, semaphore, &completedValue);
+        }
+        return value <= completedValue;
+    }
+
+    void wait(uint64_t value, VkDevice device) {
+        if (value <= completedValue) {
+            return;
+        }
+
+        VkSemaphoreWaitInfoKHR waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore;
+        waitInfo.pValues = &value;
+        if (vkWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for timeline semaphore!");
+        }
+        completedValue = value;
+    }
+};
+
+// Persistently mapped staging buffer used as ring for all uploads to device local memory.
+// Regions are handed out in order and reclaimed once the timeline reached the value of the submission that read them.
+struct StagingRingBuffer {
+    static constexpr VkDeviceSize DEFAULT_SIZE = VkDeviceSize(64) << 20;
+
+    // Allocated range of the ring together with the timeline value of its upload, 0 until the upload is submitted
+    struct StagingRegion {
+        VkDeviceSize end;
+        uint64_t timelineValue;
+    };
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation allocation;
+    VkDeviceSize size = 0;
+    VkDeviceSize offsetAlignment = 16; // region offsets respect the texel block size and optimalBufferCopyOffsetAlignment
+    VkDeviceSize head = 0; // start of free space
+    VkDeviceSize tail = 0; // start of the oldest region still in use
+    std::deque<StagingRegion> regions;
+
+    // Return size bytes of mapped staging memory, waiting for older uploads to complete if the ring is full
+    // nullptr if the ring is only blocked by regions of the upload batch that is still recorded, submit it first
+    void* allocate(VkDeviceSize regionSize, VkDeviceSize* regionOffset, GpuTimeline* timeline, VkDevice device) {
+        if (regionSize > size) {
+            throw std::runtime_error("failed to allocate staging memory, upload is larger than the staging ring buffer!");
+        }
+
+        reclaimRegions(timeline, device);
+        while (!tryAllocate(regionSize, regionOffset)) {
+            if (regions.front().timelineValue == 0) {
+                return nullptr;
+            }
+            timeline->wait(regions.front().timelineValue, device);
+            reclaimRegions(timeline, device);
+        }
+
+        return static_cast<char*>(allocation.mapped) + *regionOffset;
+    }
+
+    // All regions allocated since the last submission are read by the submission signaling timelineValue
+    void markSubmitted(uint64_t timelineValue) {
+        for (auto region = regions.rbegin(); region != regions.rend() && region->timelineValue == 0; region++) {
+            region->timelineValue = timelineValue;
+        }
+    }
+
+    void reclaimRegions(GpuTimeline* timeline, VkDevice device) {
+        while (!regions.empty() && regions.front().timelineValue != 0 && timeline->isComplete(regions.front().timelineValue, device)) {
+            tail = regions.front().end;
+            regions.pop_front();
+        }
+        if (regions.empty()) {
+            head = 0;
+            tail = 0;
+        }
+    }
+
+    // Called once the device is idle and all uploads are complete
+    void destroy(VkDevice device, DeviceMemoryAllocator* deviceMemoryAllocator) {
+        regions.clear();
+        vkDestroyBuffer(device, buffer, hostAllocator);
+        deviceMemoryAllocator->free(allocation, device);
+    }
+
+private:
+    bool tryAllocate(VkDeviceSize regionSize, VkDeviceSize* regionOffset) {
+        VkDeviceSize start = (head + offsetAlignment - 1) / offsetAlignment * offsetAlignment;
+
+        if (regions.empty()) {
+            start = 0;
+        } else if (head > tail) {
+            // used range is [tail, head), free space at the end of the ring or wrapped around to its start
+            if (start + regionSize > size) {
+                if (regionSize > tail) {
+                    return false;
+                }
+                start = 0;
+            }
+        } else if (start + regionSize > tail) {
+            // wrapped around, free space is [head, tail)
+            return false;
+        }
+
+        *regionOffset = start;
+        head = start + regionSize;
+        regions.push_back(StagingRegion{ head, 0 });
+        return true;
+    }
+};
+
+// Copies and layout transitions of several uploads recorded into one command buffer and submitted once, completion is tracked on the GpuTimeline.
+// With a dedicated transfer queue the copies run there and the uploaded resources are handed over to the graphics queue by
+// queue family ownership transfers, the acquiring submission waits on transferCompleteSemaphore.
+struct UploadBatch {
+    VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE; // copies and ownership releases, submitted to transferQueue
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // ownership acquires, submitted to graphicsQueue
+    VkSemaphore transferCompleteSemaphore = VK_NULL_HANDLE;
+    uint64_t timelineValue = 0; // reached once both command buffers of the latest submission completed
+    bool recording = false;
+
+    // handles the batch was created with, owned by the application
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkQueue graphicsQueue = VK_NULL_HANDLE;
+    uint32_t transferQueueFamily = 0;
+    uint32_t graphicsQueueFamily = 0;
+    GpuTimeline* timeline = nullptr;
+
+    bool usesTransferQueue() const {
+        return transferQueueFamily != graphicsQueueFamily;
+    }
+};
+
+// Command buffers recorded once and submitted again every frame (cacheCommandBuffers). There is one per frame in flight and swapchain
+// image, as the recorded commands reference the descriptor set of the frame and the framebuffer of the image.
+struct CommandBufferCache {
+    std::vector<VkCommandBuffer> commandBuffers; // [frame in flight * imageCount + swapchain image]
+    std::vector<bool> dirty; // the command buffer has to be recorded before its next submission
+    uint32_t imageCount = 0;
+
+    VkCommandBuffer* get(uint32_t frame, uint32_t imageIndex) {
+        return &commandBuffers[frame * imageCount + imageIndex];
+    }
+
+    bool isDirty(uint32_t frame, uint32_t imageIndex) const {
+        return dirty[frame * imageCount + imageIndex];
+    }
+
+    void markRecorded(uint32_t frame, uint32_t imageIndex) {
+        dirty[frame * imageCount + imageIndex] = false;
+    }
+
+    // call whenever recorded state changes: pipelines, draws of the scene, buffers or descriptor sets bound by recordCommandBuffer
+    void invalidate() {
+        std::fill(dirty.begin(), dirty.end(), true);
+    }
+};
+
+// Persistent worker threads recording the secondary command buffers of recordingThreadCount. The workers are created once and woken
+// for every frame, as starting a thread per secondary command buffer every frame costs as much as recording thousands of draws.
+struct RecordingThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition; // a new batch of tasks is available or the pool stops
+    std::condition_variable doneCondition; // all workers finished their task of the batch
+    const std::function<void(uint32_t)>* task = nullptr; // valid until run returns
+    uint32_t taskCount = 0;
+    uint64_t generation = 0; // incremented for every batch, each worker runs every batch once
+    uint32_t pendingWorkerCount = 0;
+    std::exception_ptr workerError;
+    bool stopping = false;
+
+    ~RecordingThreadPool() {
+        stop();
+    }
+
+    // worker i runs task i + 1 of every batch, task 0 runs on the calling thread
+    void start(uint32_t workerCount) {
+        for (uint32_t i = 0; i < workerCount; i++) {
+            workers.emplace_back(&RecordingThreadPool::work, this, i + 1);
+        }
+    }
+
+    // Run the tasks 0 to count - 1 and return once all of them finished, errors of the workers are rethrown on the calling thread
+    void run(uint32_t count, const std::function<void(uint32_t)>& batchTask) {
+        if (count > workers.size() + 1) {
+            throw std::runtime_error("failed to run recording tasks, more tasks than recording threads!");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &batchTask;
+            taskCount = count;
+            pendingWorkerCount = static_cast<uint32_t>(workers.size());
+            workerError = nullptr;
+            generation++;
+        }
+        wakeCondition.notify_all();
+
+        // the workers reference batchTask, so wait for them even if the task of the calling thread fails
+        std::exception_ptr error;
+        try {
+            batchTask(0);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this]() { return pendingWorkerCount == 0; });
+        task = nullptr;
+        if (!error) {
+            error = workerError;
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        stopping = false;
+    }
+
+private:
+    void work(uint32_t taskIndex) {
+        uint64_t finishedGeneration = 0;
+        while (true) {
+            const std::function<void(uint32_t)>* batchTask;
+            bool hasTask;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeCondition.wait(lock, [&]() { return stopping || generation != finishedGeneration; });
+                if (stopping) {
+                    return;
+                }
+                finishedGeneration = generation;
+                batchTask = task;
+                hasTask = taskIndex < taskCount;
+            }
+
+            std::exception_ptr error;
+            if (hasTask) {
+                try {
+                    (*batchTask)(taskIndex);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error && !workerError) {
+                workerError = error;
+            }
+            if (--pendingWorkerCount == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+};
+
+// Frame pacing of lowLatencyMode: the effective frames in flight, adapted to the measured frame times, and the input latency.
+// Latency is measured from polling input to the present being visible with presentWait, to the frame completing on the GPU otherwise.
+struct FramePacer {
+    static constexpr double SMOOTHING = 0.1; // weight of a new measurement in the moving averages
+    static constexpr double SHRINK_THRESHOLD = 0.8; // fewer frames in flight only once the work fits with some headroom
+
+    // a frame waits until the frame submitted framesInFlight frames before it completed
+    uint32_t framesInFlight = GVEProject::MAX_FRAMES_IN_FLIGHT;
+    double cpuMilliseconds = 0.0; // from polling input to submission
+    double gpuMilliseconds = 0.0; // execution of the frame's command buffer, from timestamp queries
+    double refreshMilliseconds = 1000.0 / 60.0;
+
+    uint64_t presentId = 0; // id of the latest present
+    uint64_t firstSwapchainPresentId = 1; // present ids of older swapchains can't be waited for
+
+    // input time of frames whose latency is not measured yet
+    struct PendingFrame {
+        uint64_t presentId;
+        uint64_t timelineValue;
+        std::chrono::steady_clock::time_point inputTime;
+    };
+    std::deque<PendingFrame> pendingFrames;
+
+    double latencySumMilliseconds = 0.0;
+    double latencyMaxMilliseconds = 0.0;
+    uint32_t latencyCount = 0;
+
+    void addMeasurement(double* average, double milliseconds) {
+        *average = *average == 0.0 ? milliseconds : *average + SMOOTHING * (milliseconds - *average);
+    }
+
+    // A frame spanning less than one refresh is done before the next one starts, more frames in flight only add queueing.
+    // Longer frames need CPU and GPU to work on different frames in parallel to keep up with the display.
+    void adaptFramesInFlight() {
+        double frameMilliseconds = cpuMilliseconds + gpuMilliseconds;
+        uint32_t requiredFrames = static_cast<uint32_t>(std::ceil(frameMilliseconds / refreshMilliseconds));
+        requiredFrames = std::clamp(requiredFrames, 1u, static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT));
+        if (requiredFrames > framesInFlight || frameMilliseconds < SHRINK_THRESHOLD * refreshMilliseconds * (framesInFlight - 1)) {
+            framesInFlight = requiredFrames;
+        }
+    }
+
+    // called when the frame or present identified by the predicate is known to be complete, pending frames complete in order
+    template<typename IsComplete>
+    void measureLatency(IsComplete isComplete) {
+        auto now = std::chrono::steady_clock::now();
+        while (!pendingFrames.empty() && isComplete(pendingFrames.front())) {
+            double latency = std::chrono::duration<double, std::milli>(now - pendingFrames.front().inputTime).count();
+            latencySumMilliseconds += latency;
+            latencyMaxMilliseconds = std::max(latencyMaxMilliseconds, latency);
+            latencyCount++;
+            pendingFrames.pop_front();
+        }
+    }
+
+    void swapchainRecreated() {
+        firstSwapchainPresentId = presentId + 1;
+        pendingFrames.clear();
+    }
+
+    void printStatistics(bool presentWait) {
+        std::cout << "Latency (input to " << (presentWait ? "present" : "GPU completion") << "): average " << (latencyCount > 0 ? latencySumMilliseconds / latencyCount : 0.0)
+            << " ms, max " << latencyMaxMilliseconds << " ms, CPU " << cpuMilliseconds << " ms, GPU " << gpuMilliseconds << " ms, " << framesInFlight << " frames in flight" << std::endl;
+        latencySumMilliseconds = 0.0;
+        latencyMaxMilliseconds = 0.0;
+        latencyCount = 0;
+    }
+};
+
+// Frames a benchmark draws with one setting: each setting is measured for STEP_SECONDS, slow settings at least until MIN_MEASURED_FRAMES
+// frames were measured. Measurements of the first frames in flight of a step are skipped, they were still submitted with the previous setting.
+struct BenchmarkStep {
+    static constexpr double STEP_SECONDS = 3.0;
+    static constexpr uint32_t MIN_MEASURED_FRAMES = 10;
+
+    std::chrono::steady_clock::time_point startTime;
+    uint32_t frameCount = 0; // frames drawn with the current setting
+
+    void addFrame() {
+        if (frameCount == 0) {
+            startTime = std::chrono::steady_clock::now();
+        }
+        frameCount++;
+    }
+
+    bool isMeasured() const {
+        return frameCount > GVEProject::MAX_FRAMES_IN_FLIGHT;
+    }
+
+    bool isComplete() const {
+        return frameCount >= GVEProject::MAX_FRAMES_IN_FLIGHT + MIN_MEASURED_FRAMES
+            && std::chrono::steady_clock::now() - startTime >= std::chrono::duration<double>(STEP_SECONDS);
+    }
+
+    void next() {
+        frameCount = 0;
+    }
+};
+
+// Scaling of an instanced draw (benchmarkInstancing): the instance count of the draws grows by a factor of 10 with every BenchmarkStep
+// up to MAX_INSTANCES, then the scene is drawn again. The averages of every count are printed when it is left.
+struct InstancingBenchmark {
+    static constexpr uint32_t MAX_INSTANCES = 1000000;
+
+    uint32_t instanceCount = 1;
+    bool finished = false;
+    BenchmarkStep step; // frames drawn with instanceCount
+    double recordingMillisecondsSum = 0.0;
+    double gpuMillisecondsSum = 0.0;
+    uint32_t gpuMeasurementCount = 0;
+
+    void addFrame(double recordingMilliseconds) {
+        recordingMillisecondsSum += recordingMilliseconds;
+        step.addFrame();
+    }
+
+    void addGpuMeasurement(double gpuMilliseconds) {
+        if (step.isMeasured()) {
+            gpuMillisecondsSum += gpuMilliseconds;
+            gpuMeasurementCount++;
+        }
+    }
+
+    // true if the instance count changed, so recorded command buffers are outdated
+    bool advance(uint32_t sceneInstanceCount) {
+        if (finished || !step.isComplete()) {
+            return false;
+        }
+        std::cout << "\t" << instanceCount << (instanceCount == 1 ? " instance: recording " : " instances: recording ") << recordingMillisecondsSum / step.frameCount << " ms, GPU ";
+        if (gpuMeasurementCount > 0) {
+            std::cout << gpuMillisecondsSum / gpuMeasurementCount << " ms" << std::endl;
+        }
+        else {
+            std::cout << "not measured" << std::endl;
+        }
+
+        step.next();
+        recordingMillisecondsSum = 0.0;
+        gpuMillisecondsSum = 0.0;
+        gpuMeasurementCount = 0;
+        if (instanceCount >= MAX_INSTANCES) {
+            finished = true;
+            instanceCount = sceneInstanceCount;
+        }
+        else {
+            instanceCount *= 10;
+        }
+        return true;
+    }
+};
+
+// Triangles submitted per frame without and with occlusion culling (benchmarkOcclusionCulling): the setting alternates with every BenchmarkStep
+// for STEP_COUNT steps, so both are measured from similar views. Occlusion culling stays enabled once both averages are printed.
+struct OcclusionCullingBenchmark {
+    static constexpr uint32_t STEP_COUNT = 6;
+
+    bool occlusionCulling = false;
+    bool finished = false;
+    uint32_t stepIndex = 0;
+    BenchmarkStep step; // frames drawn with the current setting
+    uint64_t triangleSums[2] = {}; // [occlusionCulling]
+    uint32_t measurementCounts[2] = {}; // [occlusionCulling]
+
+    void addFrame() {
+        step.addFrame();
+    }
+
+    void addMeasurement(uint64_t triangles) {
+        if (step.isMeasured()) {
+            triangleSums[occlusionCulling] += triangles;
+            measurementCounts[occlusionCulling]++;
+        }
+    }
+
+    // true if occlusion culling was switched, so recorded command buffers are outdated
+    bool advance() {
+        if (finished || !step.isComplete()) {
+            return false;
+        }
+        step.next();
+        occlusionCulling = !occlusionCulling;
+        if (++stepIndex < STEP_COUNT) {
+            return true;
+        }
+
+        double triangles[2];
+        for (int culling = 0; culling < 2; culling++) {
+            triangles[culling] = measurementCounts[culling] > 0 ? static_cast<double>(triangleSums[culling]) / measurementCounts[culling] : 0.0;
+            std::cout << (culling ? "\twith occlusion culling: " : "\twithout occlusion culling: ");
+            if (measurementCounts[culling] == 0) {
+                std::cout << "not measured" << std::endl;
+            }
+            else if (!culling || triangles[0] == 0.0) {
+                std::cout << triangles[culling] << " triangles per frame" << std::endl;
+            }
+            else {
+                std::cout << triangles[culling] << " triangles per frame (" << 100.0 * (1.0 - triangles[culling] / triangles[0]) << "% fewer)" << std::endl;
+            }
+        }
+
+        finished = true;
+        occlusionCulling = true;
+        return true;
+    }
+};
+
+// Farthest depth of the previous frame for useOcclusionCulling: level 0 is reduced from the depth attachment to the power of two below its size,
+// every further level keeps the farthest depth of 2x2 texels of the level above. The image stays in the general layout.
+// Without useOcclusionCulling the culling shader still binds a single texel at the far plane, which is never tested.
+struct DepthPyramid {
+    static constexpr uint32_t WORKGROUP_SIZE = 8; // local_size_x and local_size_y of the reduction shader
+
+    VkImage image = VK_NULL_HANDLE;
+    MemoryAllocation allocation;
+    VkExtent2D extent{};
+    uint32_t levelCount = 0;
+    VkImageView view = VK_NULL_HANDLE; // all levels, sampled by the culling shader
+    std::vector<VkImageView> levelViews; // written by the reduction of a level and read by the reduction of the next one
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    // depth attachment reduced into level 0
+    VkImage depthImage = VK_NULL_HANDLE;
+    VkImageAspectFlags depthAspectMask = 0;
+
+    // reduction, VK_NULL_HANDLE without useOcclusionCulling
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptorSets; // one per level
+
+    // the image and the reduction descriptors depend on the swapchain extent
+    void destroyImage(VkDevice device, DeviceMemoryAllocator* deviceMemoryAllocator) {
+        if (image == VK_NULL_HANDLE) {
+            return;
+        }
+        vkDestroyDescriptorPool(device, descriptorPool, hostAllocator);
+        for (VkImageView levelView : levelViews) {
+            vkDestroyImageView(device, levelView, hostAllocator);
+        }
+        vkDestroyImageView(device, view, hostAllocator);
+        vkDestroyImage(device, image, hostAllocator);
+        deviceMemoryAllocator->free(allocation, device);
+        levelViews.clear();
+        descriptorSets.clear();
+        descriptorPool = VK_NULL_HANDLE;
+        view = VK_NULL_HANDLE;
+        image = VK_NULL_HANDLE;
+    }
+
+    void destroy(VkDevice device, DeviceMemoryAllocator* deviceMemoryAllocator) {
+        destroyImage(device, deviceMemoryAllocator);
+        vkDestroySampler(device, sampler, hostAllocator);
+        vkDestroyPipeline(device, pipeline, hostAllocator);
+        vkDestroyPipelineLayout(device, pipelineLayout, hostAllocator);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostAllocator);
+    }
+};
 
-#include "GraphicalVulkanEditorProjectVariables.h"
+// Frustum culling of useGpuCulling: the compute pipeline and the buffers it writes the indirect draws of the visible objects to, one per frame in flight.
+// Without drawIndirectCount there is no pipeline, the indirect buffers are host visible and hold the single instanced draw of the CPU fallback.
+struct FrustumCulling {
+    static constexpr uint32_t WORKGROUP_SIZE = 64; // local_size_x of the culling shader
+
+    // push constants of the culling shader
+    struct Parameters {
+        glm::vec4 boundingSphere; // center and radius of the model in model space
+        uint32_t objectCount;
+        uint32_t indexCount;
+        uint32_t occlusionCulling; // nonzero to test the objects against the depth pyramid
+    };
 
+    Parameters parameters{};
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> descriptorSets;
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<MemoryAllocation> indirectBuffersAllocations;
+    std::vector<VkBuffer> drawCountBuffers; // number of draws in the indirect buffer, written by the culling shader
+    std::vector<MemoryAllocation> drawCountBuffersAllocations;
+    DepthPyramid depthPyramid;
+
+    // buffers read by the draws of a frame in flight, VK_NULL_HANDLE if not created
+    VkBuffer getIndirectBuffer(uint32_t frame) const {
+        return frame < indirectBuffers.size() ? indirectBuffers[frame] : VK_NULL_HANDLE;
+    }
 
-#ifdef NDEBUG
-const bool enableValidationLayers = false;
-#else
-const bool enableValidationLayers = true;
-#endif
+    VkBuffer getDrawCountBuffer(uint32_t frame) const {
+        return frame < drawCountBuffers.size() ? drawCountBuffers[frame] : VK_NULL_HANDLE;
+    }
 
-const std::vector<const char*> validationLayers = {
-    "VK_LAYER_KHRONOS_validation"
+    void destroy(VkDevice device, DeviceMemoryAllocator* deviceMemoryAllocator) {
+        for (size_t i = 0; i < indirectBuffers.size(); i++) {
+            vkDestroyBuffer(device, indirectBuffers[i], hostAllocator);
+            deviceMemoryAllocator->free(indirectBuffersAllocations[i], device);
+        }
+        for (size_t i = 0; i < drawCountBuffers.size(); i++) {
+            vkDestroyBuffer(device, drawCountBuffers[i], hostAllocator);
+            deviceMemoryAllocator->free(drawCountBuffersAllocations[i], device);
+        }
+        depthPyramid.destroy(device, deviceMemoryAllocator);
+        vkDestroyPipeline(device, pipeline, hostAllocator);
+        vkDestroyPipelineLayout(device, pipelineLayout, hostAllocator);
+        vkDestroyDescriptorPool(device, descriptorPool, hostAllocator);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostAllocator);
+    }
 };
 
-const std::vector<const char*> deviceExtensions = GVEProject::DEVICE_EXTENSIONS;
-
-// Uniform object to pass to shaders
+// Uniform object to pass to shaders, shared by all objects of a frame
 struct UniformBufferObject {
     // glm types must match shader binding types for easy memcpy of ubo into a VkBuffer
-    glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
 };
 
+// Data of a single object, either pushed as push constants before its draw or, without objectDataInPushConstants, stored in the uniform buffer.
+// The uniform buffer of each frame holds the UniformBufferObject followed by the data of all objects,
+// one per objectUniformStride (a multiple of minUniformBufferOffsetAlignment), selected per draw with a dynamic offset.
+// With objectDataInInstanceBuffer the data of all objects is tightly packed into the instance buffer of the frame instead, read per instance.
+struct ObjectUniformData {
+    glm::mat4 model;
+    glm::vec4 materialColor; // multiplied with the fragment color
+};
+
+// Frustum culling of bounding spheres on the CPU, for useCpuCulling and the CPU fallback of useGpuCulling. The world space spheres are kept as
+// structure of arrays, so one SIMD register holds a coordinate of LANE_COUNT spheres and each plane is tested against all of them at once.
+// A sphere is culled if it lies completely behind one of the planes, the same test as the culling shader.
+struct SphereCuller {
+#if defined(GVE_CULLING_AVX)
+    static constexpr uint32_t LANE_COUNT = 8;
+#elif defined(GVE_CULLING_SSE) || defined(GVE_CULLING_NEON)
+    static constexpr uint32_t LANE_COUNT = 4;
+#else
+    static constexpr uint32_t LANE_COUNT = 1;
+#endif
+
+    // padded to a multiple of LANE_COUNT, lanes beyond count are never reported as visible
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    uint32_t count = 0;
+
+    void resize(uint32_t sphereCount) {
+        count = sphereCount;
+        size_t paddedCount = (static_cast<size_t>(sphereCount) + LANE_COUNT - 1) / LANE_COUNT * LANE_COUNT;
+        for (std::vector<float>* values : { &centerX, &centerY, &centerZ, &radius }) {
+            values->resize(paddedCount, 0.0f);
+        }
+    }
+
+    void setSphere(uint32_t index, const glm::vec3& center, float sphereRadius) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        radius[index] = sphereRadius;
+    }
+
+    // transform the model space bounding sphere by the model matrix of every object, scaled by its largest axis scale to stay conservative
+    void update(const std::vector<ObjectUniformData>& objects, const glm::vec4& boundingSphere) {
+        resize(static_cast<uint32_t>(objects.size()));
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::mat4& model = objects[i].model;
+            float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+            setSphere(i, glm::vec3(model * glm::vec4(glm::vec3(boundingSphere), 1.0f)), boundingSphere.w * scale);
+        }
+    }
+
+    // write the indices of the spheres intersecting the frustum in ascending order, the planes are normalized
+    void cull(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint32_t>* visible) const {
+#if defined(GVE_CULLING_AVX)
+        visible->clear();
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (size_t plane = 0; plane < frustumPlanes.size(); plane++) {
+            planeX[plane] = _mm256_set1_ps(frustumPlanes[plane].x);
+            planeY[plane] = _mm256_set1_ps(frustumPlanes[plane].y);
+            planeZ[plane] = _mm256_set1_ps(frustumPlanes[plane].z);
+            planeW[plane] = _mm256_set1_ps(frustumPlanes[plane].w);
+        }
+        for (uint32_t first = 0; first < count; first += LANE_COUNT) {
+            __m256 x = _mm256_loadu_ps(&centerX[first]);
+            __m256 y = _mm256_loadu_ps(&centerY[first]);
+            __m256 z = _mm256_loadu_ps(&centerZ[first]);
+            __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[first]));
+            __m256 outside = _mm256_setzero_ps();
+            for (size_t plane = 0; plane < frustumPlanes.size(); plane++) {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[plane], x), _mm256_mul_ps(planeY[plane], y)), _mm256_add_ps(_mm256_mul_ps(planeZ[plane], z), planeW[plane]));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+            }
+            appendVisibleLanes(first, static_cast<uint32_t>(_mm256_movemask_ps(outside)), visible);
+        }
+#elif defined(GVE_CULLING_SSE)
+        visible->clear();
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (size_t plane = 0; plane < frustumPlanes.size(); plane++) {
+            planeX[plane] = _mm_set1_ps(frustumPlanes[plane].x);
+            planeY[plane] = _mm_set1_ps(frustumPlanes[plane].y);
+            planeZ[plane] = _mm_set1_ps(frustumPlanes[plane].z);
+            planeW[plane] = _mm_set1_ps(frustumPlanes[plane].w);
+        }
+        for (uint32_t first = 0; first < count; first += LANE_COUNT) {
+            __m128 x = _mm_loadu_ps(&centerX[first]);
+            __m128 y = _mm_loadu_ps(&centerY[first]);
+            __m128 z = _mm_loadu_ps(&centerZ[first]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[first]));
+            __m128 outside = _mm_setzero_ps();
+            for (size_t plane = 0; plane < frustumPlanes.size(); plane++) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[plane], x), _mm_mul_ps(planeY[plane], y)), _mm_add_ps(_mm_mul_ps(planeZ[plane], z), planeW[plane]));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+            }
+            appendVisibleLanes(first, static_cast<uint32_t>(_mm_movemask_ps(outside)), visible);
+        }
+#elif defined(GVE_CULLING_NEON)
+        visible->clear();
+        for (uint32_t first = 0; first < count; first += LANE_COUNT) {
+            float32x4_t x = vld1q_f32(&centerX[first]);
+            float32x4_t y = vld1q_f32(&centerY[first]);
+            float32x4_t z = vld1q_f32(&centerZ[first]);
+            float32x4_t negativeRadius = vnegq_f32(vld1q_f32(&radius[first]));
+            uint32x4_t outside = vdupq_n_u32(0);
+            for (const glm::vec4& plane : frustumPlanes) {
+                float32x4_t distance = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(plane.w), x, plane.x), y, plane.y), z, plane.z);
+                outside = vorrq_u32(outside, vcltq_f32(distance, negativeRadius));
+            }
+            uint32_t outsideLanes[4];
+            vst1q_u32(outsideLanes, outside);
+            uint32_t outsideMask = 0;
+            for (uint32_t lane = 0; lane < LANE_COUNT; lane++) {
+                outsideMask |= (outsideLanes[lane] & 1u) << lane;
+            }
+            appendVisibleLanes(first, outsideMask, visible);
+        }
+#else
+        cullScalar(frustumPlanes, visible);
+#endif
+    }
+
+    // reference without SIMD, also used by benchmarkCpuCulling
+    void cullScalar(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint32_t>* visible) const {
+        visible->clear();
+        for (uint32_t i = 0; i < count; i++) {
+            bool inside = true;
+            for (const glm::vec4& plane : frustumPlanes) {
+                if (plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w < -radius[i]) {
+                    inside = false;
+                    break;
+                }
+            }
+            if (inside) {
+                visible->push_back(i);
+            }
+        }
+    }
+
+private:
+    void appendVisibleLanes(uint32_t first, uint32_t outsideMask, std::vector<uint32_t>* visible) const {
+        for (uint32_t lane = 0; lane < LANE_COUNT && first + lane < count; lane++) {
+            if ((outsideMask & (1u << lane)) == 0) {
+                visible->push_back(first + lane);
+            }
+        }
+    }
+};
+
 // Wrapper struct containing Vertex information for further processing such as position, color and functions to forward shader input variables.
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 color;
     glm::vec2 texCoord;
 
-    static const uint32_t attributeCount = 3; // set amount of attributes 
+    static const uint32_t bindingCount = 2; // binding 0: vertices, binding 1: ObjectUniformData per instance
+    static const uint32_t attributeCount = 8; // set amount of attributes 
 
     // vertex binding describes at which rate to load data from memory throughout the vertices. It specifies the number of bytes between data entries and whether to move to the next data entry after each vertex or after each instance.
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
+    static std::array<VkVertexInputBindingDescription, bindingCount> getBindingDescriptions() {
+        std::array<VkVertexInputBindingDescription, bindingCount> bindingDescriptions{};
         // binding : specifies the index of the binding in the array of bindings.
         // stride : specifies the number of bytes from one entry to the next
         // inputRate : can have one of the following values:
         // VK_VERTEX_INPUT_RATE_VERTEX: Move to the next data entry after each vertex
         // VK_VERTEX_INPUT_RATE_INSTANCE : Move to the next data entry after each instance
-        bindingDescription.binding = 0; 
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        bindingDescriptions[0].binding = 0; 
+        bindingDescriptions[0].stride = sizeof(Vertex);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-        return bindingDescription;
+        // the instance buffer is always bound, the shader only reads it with objectDataInInstanceBuffer
+        bindingDescriptions[1].binding = 1;
+        bindingDescriptions[1].stride = sizeof(ObjectUniformData);
+        bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescriptions;
     }
 
     // set vertex shader input variables and bind them to vulkan
@@ -136,6 +1633,19 @@ struct Vertex {
         attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
         attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
 
+        // a mat4 input occupies one location per column: layout(location = 3) in mat4 instanceModel;
+        for (uint32_t column = 0; column < 4; column++) {
+            attributeDescriptions[3 + column].binding = 1;
+            attributeDescriptions[3 + column].location = 3 + column;
+            attributeDescriptions[3 + column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[3 + column].offset = static_cast<uint32_t>(offsetof(ObjectUniformData, model) + column * sizeof(glm::vec4));
+        }
+
+        attributeDescriptions[7].binding = 1;
+        attributeDescriptions[7].location = 7; // layout(location = 7) in vec4 instanceMaterialColor;
+        attributeDescriptions[7].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[7].offset = offsetof(ObjectUniformData, materialColor);
+
         // add more attribute descriptions for more shader input variables
 
         return attributeDescriptions;
@@ -206,7 +1716,7 @@ private:
         std::vector<tinyobj::material_t> materials;
         std::string warn, err;
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, GVEProject::MODEL_FILE.c_str())) {
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, GVEProject::MODEL_FILE)) {
             throw std::runtime_error(warn + err);
         }
 
@@ -250,12 +1760,12 @@ public:
         return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
     }
 
-    //  helper function to select a format with a depth component that supports usage as depth attachment:
+    //  helper function to select a format with a depth component that supports usage as depth attachment, sampled by the depth pyramid reduction of useOcclusionCulling:
     static VkFormat findDepthFormat(VkPhysicalDevice* physicalDevice) {
         return findSupportedFormat(
             { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
             VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | (useOcclusionCulling ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0),
             physicalDevice
         );
     }
@@ -284,15 +1794,24 @@ private:
 
     //Depth images should have the same resolution as the color attachment, defined by the swap chain extent, an image usage appropriate for a depth attachment, optimal tiling and device local memory.
 
-    void createDepthResources(VkImage* depthImage, VkDeviceMemory* depthImageMemory, VkImageView* depthImageView, VkExtent2D* swapChainExtent, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    void createDepthResources(VkImage* depthImage, MemoryAllocation* depthImageAllocation, VkImageView* depthImageView, DeviceCapabilities* deviceCapabilities, DeviceMemoryAllocator* deviceMemoryAllocator, VkExtent2D* swapChainExtent, VkDevice* device, VkPhysicalDevice* physicalDevice) {
         VkFormat depthFormat = findDepthFormat(physicalDevice);
 
-        createImage(swapChainExtent->width, swapChainExtent->height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *depthImage, *depthImageMemory, device, physicalDevice);
+        // the depth only lives within the render pass, unless it is reduced into the depth pyramid afterwards
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (useOcclusionCulling ? 0 : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+        createImage(swapChainExtent->width, swapChainExtent->height, 1, deviceCapabilities->msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENTS, *depthImage, *depthImageAllocation, deviceMemoryAllocator, device, physicalDevice);
         *depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, device);
 
         // layout transition not explicitly necessary as it is taken care of in the render pass
     }
 
+    // Multisampled color attachment, only needed with msaaSamples above 1. It is resolved into the swapchain image at the end of the render pass
+    // and never stored, so it is a transient attachment.
+    void createColorResources(VkImage* colorImage, MemoryAllocation* colorImageAllocation, VkImageView* colorImageView, VkFormat* swapChainImageFormat, DeviceCapabilities* deviceCapabilities, DeviceMemoryAllocator* deviceMemoryAllocator, VkExtent2D* swapChainExtent, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        createImage(swapChainExtent->width, swapChainExtent->height, 1, deviceCapabilities->msaaSamples, *swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENTS, *colorImage, *colorImageAllocation, deviceMemoryAllocator, device, physicalDevice);
+        *colorImageView = createImageView(colorImage, *swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, device);
+    }
+
 
     //////////////////////////////////////////////////
     /*         Section for (texture) Images         */
@@ -317,7 +1836,7 @@ private:
         // anisotropic filtering, use maximum available anisotropic value (= amount of texel samples that can be used to calculate the final color) for best results (at cost of performace)
         samplerInfo.anisotropyEnable = GVEProject::ENABLE_ANISOTRIPIC_FILTER;
         samplerInfo.maxAnisotropy = 1.0f;
-        if (GVEProject::ENABLE_ANISOTRIPIC_FILTER) {
+        if constexpr (GVEProject::ENABLE_ANISOTRIPIC_FILTER) {
             VkPhysicalDeviceProperties properties{};
             vkGetPhysicalDeviceProperties(*physicalDevice, &properties);
             samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
@@ -341,7 +1860,7 @@ private:
         samplerInfo.minLod = 0.0f;
         samplerInfo.maxLod = 0.0f;
 
-        if (vkCreateSampler(*device, &samplerInfo, nullptr, textureSampler) != VK_SUCCESS) {
+        if (vkCreateSampler(*device, &samplerInfo, hostAllocator, textureSampler) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture sampler!");
         }
     }
@@ -368,7 +1887,7 @@ private:
         viewInfo.subresourceRange.layerCount = 1; // for stereoscopic 3D applications, use multiple layers to access views for left and right eye
 
         VkImageView imageView;
-        if (vkCreateImageView(*device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        if (vkCreateImageView(*device, &viewInfo, hostAllocator, &imageView) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture image view!");
         }
 
@@ -379,12 +1898,10 @@ private:
         *textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, device);
     }
 
-    // helper function, contents may be recorded into setup buffer and flused as single commandbuffer
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(commandPool, device);
-
+    // recorded into the upload batch, see beginUploadBatch
+    void copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height, VkCommandBuffer commandBuffer) {
         VkBufferImageCopy region{};
-        region.bufferOffset = 0; // byte offset of pixel start-points
+        region.bufferOffset = bufferOffset; // byte offset of pixel start-points
         region.bufferRowLength = 0; // specify in-memory layout, e.g. padding or tightly packed
         region.bufferImageHeight = 0;
 
@@ -408,11 +1925,10 @@ private:
             1,
             &region // may contain an array of pixels to copy from buffer into image
         );
-
-        endSingleTimeCommands(commandBuffer, commandPool, graphicsQueue, device);
     }
 
-    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    // Returns false with image set to VK_NULL_HANDLE if the allocator throttled the allocation of a streamed category
+    bool createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkImage& image, MemoryAllocation& imageAllocation, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
 
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -420,65 +1936,59 @@ private:
         imageInfo.extent.width = static_cast<uint32_t>(width);
         imageInfo.extent.height = static_cast<uint32_t>(height);
         imageInfo.extent.depth = 1;
-        imageInfo.mipLevels = 1;
+        imageInfo.mipLevels = mipLevels;
         imageInfo.arrayLayers = 1;
         imageInfo.format = format; // use the same image format for texel as the pixels in the buffer, else copy will fail
         imageInfo.tiling = tiling; // optimal:  Texels are laid out in an implementation defined order for optimal access; linear: Texels are laid out in row-major order like our pixels array, use linear for direct access of texels in memory 
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; //undefined: discard texels on first transition, use when image is a transfer destination and texel data is copied into it from a buffer, preinitialized: keep texels on first transition, useful when having staging images 
-        imageInfo.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.usage = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ? usage : usage | VK_IMAGE_USAGE_SAMPLED_BIT; // transient images may only be used as attachments
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; //used only by one queue family, which is graphics supporting
-        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT; //used for multisampling
+        imageInfo.samples = numSamples; //used for multisampling
         imageInfo.flags = 0; // Optional
 
-        if (vkCreateImage(*device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        if (vkCreateImage(*device, &imageInfo, hostAllocator, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
 
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(*device, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, physicalDevice);
-
-        if (vkAllocateMemory(*device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
+        // attachments that are never loaded or stored may stay in tile memory, lazily allocated memory is only backed if the device needs it
+        VkMemoryPropertyFlags lazyProperties = properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        bool lazilyAllocated = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && hasMemoryType(memRequirements.memoryTypeBits, lazyProperties, physicalDevice);
+        uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, lazilyAllocated ? lazyProperties : properties, physicalDevice);
+        imageAllocation = deviceMemoryAllocator->allocate(memRequirements, memoryTypeIndex, tiling == VK_IMAGE_TILING_OPTIMAL, category, *device);
+        if (imageAllocation.memory == VK_NULL_HANDLE) {
+            vkDestroyImage(*device, image, hostAllocator);
+            image = VK_NULL_HANDLE;
+            return false;
         }
 
-        vkBindImageMemory(*device, image, imageMemory, 0);
+        vkBindImageMemory(*device, image, imageAllocation.memory, imageAllocation.offset);
+        return true;
     }
 
-    void createTextureImage(VkDeviceMemory* textureImageMemory, VkImage* textureImage, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    void createTextureImage(MemoryAllocation* textureImageAllocation, VkImage* textureImage, UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
         int texWidth, texHeight, texChannels;
         //stbi_uc* pixels = stbi_load("textures/texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        stbi_uc* pixels = stbi_load(GVEProject::TEXTURE_FILE.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha); // load pixels from texture file
+        stbi_uc* pixels = stbi_load(GVEProject::TEXTURE_FILE, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha); // load pixels from texture file
         VkDeviceSize imageSize = texWidth * texHeight * 4; // STBI rgb alpha uses 4 bytes per pixel, increase in case of larger datatype
 
         if (!pixels) {
             throw std::runtime_error("failed to load texture image!");
         }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, device, physicalDevice);
-        void* data;
-        vkMapMemory(*device, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(*device, stagingBufferMemory);
+        VkDeviceSize stagingOffset = stageUploadData(pixels, imageSize, uploadBatch, stagingRingBuffer, device);
         stbi_image_free(pixels);
 
-        createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *textureImage, *textureImageMemory, device, physicalDevice);
+        if (!createImage(texWidth, texHeight, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_TEXTURES, *textureImage, *textureImageAllocation, deviceMemoryAllocator, device, physicalDevice)) {
+            throw std::runtime_error("failed to create texture image, the memory budget is exhausted!");
+        }
         // old image layout is of no interest (in this patricular case), therefore use layout undefined
-        transitionImageLayout(*textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, commandPool, graphicsQueue, device);
-        copyBufferToImage(stagingBuffer, *textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), commandPool, graphicsQueue, device);
-        // prepare texture image for shader access to start sampling from it 
-        transitionImageLayout(*textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, commandPool, graphicsQueue, device);
-        
-        // cleanup resources for staging buffer
-        vkDestroyBuffer(*device, stagingBuffer, nullptr);
-        vkFreeMemory(*device, stagingBufferMemory, nullptr);
+        transitionImageLayout(*textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uploadBatch->transferCommandBuffer);
+        copyBufferToImage(stagingRingBuffer->buffer, stagingOffset, *textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), uploadBatch->transferCommandBuffer);
+        // prepare texture image for shader access to start sampling from it, the transition is part of the ownership transfer
+        releaseImageToGraphicsQueue(uploadBatch, *textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
     }
 
     /////////////////////////////////////////////////
@@ -486,19 +1996,13 @@ private:
     /////////////////////////////////////////////////
 
     // this method is used to modify uniform buffers to e.g. apply matrix transformations to objects, views or cameras
-    void updateUniformBuffer(uint32_t currentImage, std::vector<void*>* uniformBuffersMapped, VkExtent2D* swapChainExtent) {
+    void updateUniformBuffer(uint32_t currentImage, std::vector<void*>* uniformBuffersMapped, std::vector<void*>* instanceBuffersMapped, VkDeviceSize objectUniformStride, std::vector<ObjectUniformData>* objectData, glm::mat4* viewProjection, VkExtent2D* swapChainExtent) {
         static auto startTime = std::chrono::high_resolution_clock::now();
 
         auto currentTime = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
         UniformBufferObject ubo{};
-        // apply model matrix changes here
-        // rotate the object by 90 degrees per second
-        // use your creativity here to play with uniform modifications of the object
-        auto rotationAngle = time * glm::radians(90.0f);
-        auto rotationAxis = glm::vec3(0.0f, 0.0f, 1.0f);
-        ubo.model = glm::rotate(glm::mat4(1.0f), rotationAngle, rotationAxis);
 
         // apply view matrix transformations here
         // loot at the object from above at 45 degree angle
@@ -519,9 +2023,133 @@ private:
 
         // GLM is designed for OpenGL, which has clip coordinates Y-inverted compared to Vulkan.
         ubo.proj[1][1] *= -1;
+        *viewProjection = ubo.proj * ubo.view;
 
         // copy data into uniform buffer without staging buffer (increases performance as it will be called each frame)
-        memcpy(uniformBuffersMapped->at(currentImage), &ubo, sizeof(ubo));
+        char* mapped = static_cast<char*>(uniformBuffersMapped->at(currentImage));
+        memcpy(mapped, &ubo, sizeof(ubo));
+
+        objectData->resize(sceneObjectCount);
+        for (uint32_t i = 0; i < sceneObjectCount; i++) {
+            objectData->at(i).model = getObjectModelMatrix(i, time);
+            objectData->at(i).materialColor = glm::vec4(1.0f);
+        }
+
+        // instances read the packed data from the instance buffer, pushed while recording,
+        // otherwise the data of all objects follows the shared data, each at its own aligned offset
+        if (objectDataInInstanceBuffer) {
+            memcpy(instanceBuffersMapped->at(currentImage), objectData->data(), sceneObjectCount * sizeof(ObjectUniformData));
+        }
+        else if (!objectDataInPushConstants) {
+            char* objectUniforms = mapped + getObjectUniformOffset(objectUniformStride);
+            for (uint32_t i = 0; i < sceneObjectCount; i++) {
+                memcpy(objectUniforms + i * objectUniformStride, &objectData->at(i), sizeof(ObjectUniformData));
+            }
+        }
+    }
+
+    // apply model matrix changes here
+    // objects are placed on a square grid around the origin and rotate by 90 degrees per second
+    // use your creativity here to play with uniform modifications of the objects
+    glm::mat4 getObjectModelMatrix(uint32_t objectIndex, float time) {
+        uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(sceneObjectCount))));
+        float spacing = 2.0f;
+        glm::vec3 position((objectIndex % gridSize - (gridSize - 1) * 0.5f) * spacing, (objectIndex / gridSize - (gridSize - 1) * 0.5f) * spacing, 0.0f);
+
+        auto rotationAngle = time * glm::radians(90.0f);
+        auto rotationAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        return glm::rotate(glm::translate(glm::mat4(1.0f), position), rotationAngle, rotationAxis);
+    }
+
+    // objects start behind the shared uniform data, aligned like every object
+    static VkDeviceSize getObjectUniformOffset(VkDeviceSize objectUniformStride) {
+        return (sizeof(UniformBufferObject) + objectUniformStride - 1) / objectUniformStride * objectUniformStride;
+    }
+
+    // Planes of the view frustum in world space, extracted from the rows of the view projection matrix and normalized.
+    // Points inside have a non-negative distance to every plane, clip space depth ranges from 0 to w in Vulkan.
+    static std::array<glm::vec4, 6> getFrustumPlanes(const glm::mat4& viewProjection) {
+        glm::mat4 rows = glm::transpose(viewProjection);
+        std::array<glm::vec4, 6> planes = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+        for (glm::vec4& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return planes;
+    }
+
+    // Bounding sphere of the model in model space, centered on the bounds of its vertices
+    static glm::vec4 getModelBoundingSphere() {
+        glm::vec3 minimum(std::numeric_limits<float>::max());
+        glm::vec3 maximum(-std::numeric_limits<float>::max());
+        for (const Vertex& vertex : vertices) {
+            minimum = glm::min(minimum, vertex.pos);
+            maximum = glm::max(maximum, vertex.pos);
+        }
+        glm::vec3 center = (minimum + maximum) * 0.5f;
+        float radius = 0.0f;
+        for (const Vertex& vertex : vertices) {
+            radius = std::max(radius, glm::length(vertex.pos - center));
+        }
+        return glm::vec4(center, radius);
+    }
+
+    // Cull the objects of the frame into visibleObjects, true if they differ from the previous frame. As CPU fallback of useGpuCulling
+    // without drawIndirectCount the visible objects are packed to the front of the instance buffer and counted in its indirect draw.
+    bool cullObjectsOnCpu(uint32_t currentImage, const std::vector<ObjectUniformData>* objectData, const glm::mat4& viewProjection, const glm::vec4& boundingSphere, SphereCuller* sphereCuller, std::vector<uint32_t>* visibleObjects, std::vector<uint32_t>* previousVisibleObjects, std::vector<void*>* instanceBuffersMapped, FrustumCulling* frustumCulling) {
+        previousVisibleObjects->swap(*visibleObjects);
+        sphereCuller->update(*objectData, boundingSphere);
+        sphereCuller->cull(getFrustumPlanes(viewProjection), visibleObjects);
+
+        if (useGpuCulling) {
+            ObjectUniformData* instances = static_cast<ObjectUniformData*>(instanceBuffersMapped->at(currentImage));
+            for (size_t i = 0; i < visibleObjects->size(); i++) {
+                instances[i] = objectData->at(visibleObjects->at(i));
+            }
+
+            VkDrawIndexedIndirectCommand* draw = static_cast<VkDrawIndexedIndirectCommand*>(frustumCulling->indirectBuffersAllocations[currentImage].mapped);
+            draw->indexCount = frustumCulling->parameters.indexCount;
+            draw->instanceCount = static_cast<uint32_t>(visibleObjects->size());
+            draw->firstIndex = 0;
+            draw->vertexOffset = 0;
+            draw->firstInstance = 0;
+        }
+        return *visibleObjects != *previousVisibleObjects;
+    }
+
+    // Measure culling growing numbers of random bounding spheres around the origin, part of them outside of the frustum, with SIMD and scalar code
+    void benchmarkCpuCullingPaths(const glm::mat4& viewProjection) {
+        std::array<glm::vec4, 6> frustumPlanes = getFrustumPlanes(viewProjection);
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+
+        std::cout << "CPU culling benchmark (" << SphereCuller::LANE_COUNT << " SIMD lanes):" << std::endl;
+        for (uint32_t sphereCount : { 1000u, 10000u, 100000u, 1000000u }) {
+            SphereCuller sphereCuller;
+            sphereCuller.resize(sphereCount);
+            for (uint32_t i = 0; i < sphereCount; i++) {
+                sphereCuller.setSphere(i, glm::vec3(position(random), position(random), position(random)), 0.5f);
+            }
+            std::vector<uint32_t> visible;
+            visible.reserve(sphereCount);
+
+            auto measureMicroseconds = [&](bool simd) {
+                const int repetitions = 10;
+                auto startTime = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < repetitions; i++) {
+                    if (simd) {
+                        sphereCuller.cull(frustumPlanes, &visible);
+                    }
+                    else {
+                        sphereCuller.cullScalar(frustumPlanes, &visible);
+                    }
+                }
+                return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - startTime).count() / repetitions;
+            };
+
+            double simdMicroseconds = measureMicroseconds(true);
+            double scalarMicroseconds = measureMicroseconds(false);
+            std::cout << "\t" << sphereCount << " objects (" << visible.size() << " visible): SIMD " << sphereCount / simdMicroseconds << " objects/us, scalar " << sphereCount / scalarMicroseconds << " objects/us" << std::endl;
+        }
     }
 
     /////////////////////////////////////////////////////////////////////////
@@ -531,11 +2159,13 @@ private:
     // Use descriptor pools to allocate descriptor sets 
     void createDescriptorPool(VkDescriptorPool* descriptorPool, VkDevice* device) {
         // create one poolsize for each descriptor, here we use one for uniform buffer and one for combined image sampler (for textures)
-        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        std::array<VkDescriptorPoolSize, 3> poolSizes{};
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         poolSizes[0].descriptorCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);  // create descriptor set for each frame in flight with the same layout, not explicity necesary but recommended for best practice
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         poolSizes[1].descriptorCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);  // create descriptor set for each frame in flight with the same layout, not explicity necesary but recommended for best practice
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[2].descriptorCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -543,12 +2173,12 @@ private:
         poolInfo.pPoolSizes = poolSizes.data();
         poolInfo.maxSets = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);
 
-        if (vkCreateDescriptorPool(*device, &poolInfo, nullptr, descriptorPool) != VK_SUCCESS) {
+        if (vkCreateDescriptorPool(*device, &poolInfo, hostAllocator, descriptorPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor pool!");
         }
     }
 
-    void createDescriptorSets(VkSampler* textureSampler, VkImageView* textureImageView, std::vector<VkDescriptorSet>* descriptorSets, VkDescriptorPool* descriptorPool, VkDescriptorSetLayout* descriptorSetLayout, std::vector<VkBuffer>* uniformBuffers, VkDevice* device) {
+    void createDescriptorSets(VkSampler* textureSampler, VkImageView* textureImageView, std::vector<VkDescriptorSet>* descriptorSets, VkDescriptorPool* descriptorPool, VkDescriptorSetLayout* descriptorSetLayout, std::vector<VkBuffer>* uniformBuffers, VkDeviceSize objectUniformStride, VkDevice* device) {
         std::vector<VkDescriptorSetLayout> layouts(GVEProject::MAX_FRAMES_IN_FLIGHT, *descriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -568,13 +2198,19 @@ private:
             bufferInfo.offset = 0;
             bufferInfo.range = sizeof(UniformBufferObject);
 
+            // the object binding covers a single object, the dynamic offset passed when binding the set selects which one
+            VkDescriptorBufferInfo objectBufferInfo{};
+            objectBufferInfo.buffer = uniformBuffers->at(i);
+            objectBufferInfo.offset = getObjectUniformOffset(objectUniformStride);
+            objectBufferInfo.range = sizeof(ObjectUniformData);
+
             // setup descriptor resources for combined image sampler
             VkDescriptorImageInfo imageInfo{};
             imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
             imageInfo.imageView = *textureImageView;
             imageInfo.sampler = *textureSampler;
 
-            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
             // setup descriptor resources for uniform buffer
             descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptorWrites[0].dstSet = descriptorSets->at(i);
@@ -594,6 +2230,14 @@ private:
             descriptorWrites[1].descriptorCount = 1;
             descriptorWrites[1].pImageInfo = &imageInfo;
 
+            descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[2].dstSet = descriptorSets->at(i);
+            descriptorWrites[2].dstBinding = 2; // binding index for per-object uniforms
+            descriptorWrites[2].dstArrayElement = 0;
+            descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            descriptorWrites[2].descriptorCount = 1;
+            descriptorWrites[2].pBufferInfo = &objectBufferInfo;
+
             vkUpdateDescriptorSets(*device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
         }
 
@@ -616,15 +2260,24 @@ private:
         samplerLayoutBinding.pImmutableSamplers = nullptr;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // indicate that sampler descriptor will be used in fragment shader, use in vertex shader to e.g. deform grids for heightmaps 
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = { 
+        // per-object uniform descriptor, its offset is given when binding the set so one descriptor set serves all objects
+        VkDescriptorSetLayoutBinding objectLayoutBinding{};
+        objectLayoutBinding.binding = 2;
+        objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        objectLayoutBinding.descriptorCount = 1;
+        objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        objectLayoutBinding.pImmutableSamplers = nullptr;
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = { 
             uboLayoutBinding, 
-            samplerLayoutBinding };
+            samplerLayoutBinding,
+            objectLayoutBinding };
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
         layoutInfo.pBindings = bindings.data();
 
-        if (vkCreateDescriptorSetLayout(*device, &layoutInfo, nullptr, descriptorSetLayout) != VK_SUCCESS) {
+        if (vkCreateDescriptorSetLayout(*device, &layoutInfo, hostAllocator, descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
     }
@@ -644,155 +2297,617 @@ private:
             }
         }
 
-        throw std::runtime_error("failed to find suitable memory type!");
+        throw std::runtime_error("failed to find suitable memory type!");
+
+    }
+
+    // optional memory properties such as lazily allocated memory are not offered by every device
+    bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkPhysicalDevice* physicalDevice) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(*physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+    
+    // transferCommandPool and transferQueue are the graphics ones if the device has no dedicated transfer queue
+    void createUploadBatch(UploadBatch* uploadBatch, VkCommandPool* transferCommandPool, VkCommandPool* commandPool, VkQueue* transferQueue, VkQueue* graphicsQueue, GpuTimeline* gpuTimeline, DeviceCapabilities* deviceCapabilities, VkDevice* device) {
+        uploadBatch->transferCommandPool = *transferCommandPool;
+        uploadBatch->commandPool = *commandPool;
+        uploadBatch->transferQueue = *transferQueue;
+        uploadBatch->graphicsQueue = *graphicsQueue;
+        uploadBatch->transferQueueFamily = deviceCapabilities->transferQueueFamily;
+        uploadBatch->graphicsQueueFamily = deviceCapabilities->graphicsQueueFamily;
+        uploadBatch->timeline = gpuTimeline;
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        allocInfo.commandPool = *transferCommandPool;
+        if (vkAllocateCommandBuffers(*device, &allocInfo, &uploadBatch->transferCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+        allocInfo.commandPool = *commandPool;
+        if (vkAllocateCommandBuffers(*device, &allocInfo, &uploadBatch->commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        if (vkCreateSemaphore(*device, &semaphoreInfo, hostAllocator, &uploadBatch->transferCompleteSemaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload synchronization objects!");
+        }
+    }
+
+    // start recording uploads, only waits if the previous submission of the batch is still executing
+    void beginUploadBatch(UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer, VkDevice* device) {
+        uploadBatch->timeline->wait(uploadBatch->timelineValue, *device);
+        stagingRingBuffer->reclaimRegions(uploadBatch->timeline, *device);
+
+        // the pools are transient and hold no other command buffers, resetting them is cheaper than resetting single command buffers
+        vkResetCommandPool(*device, uploadBatch->transferCommandPool, 0);
+        vkResetCommandPool(*device, uploadBatch->commandPool, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(uploadBatch->transferCommandBuffer, &beginInfo) != VK_SUCCESS ||
+            vkBeginCommandBuffer(uploadBatch->commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording upload command buffer!");
+        }
+        uploadBatch->recording = true;
+    }
+
+    // submit all recorded uploads at once, the staging regions are reclaimed once the timeline reached the value of the batch
+    // no queue wait: later submissions on the graphics queue are ordered after the copies by their barriers
+    void submitUploadBatch(UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer) {
+        if (vkEndCommandBuffer(uploadBatch->transferCommandBuffer) != VK_SUCCESS || vkEndCommandBuffer(uploadBatch->commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload command buffer!");
+        }
+
+        // the submission to the graphics queue signals the timeline, it completes after the transfer submission it waits for
+        uploadBatch->timelineValue = uploadBatch->timeline->nextValue();
+        VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+        timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineSubmitInfo.signalSemaphoreValueCount = 1;
+        timelineSubmitInfo.pSignalSemaphoreValues = &uploadBatch->timelineValue;
+
+        if (uploadBatch->usesTransferQueue()) {
+            // copies overlap with rendering on the transfer queue, only the small acquire submission runs on the graphics queue
+            VkSubmitInfo transferSubmitInfo{};
+            transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            transferSubmitInfo.commandBufferCount = 1;
+            transferSubmitInfo.pCommandBuffers = &uploadBatch->transferCommandBuffer;
+            transferSubmitInfo.signalSemaphoreCount = 1;
+            transferSubmitInfo.pSignalSemaphores = &uploadBatch->transferCompleteSemaphore;
+
+            if (vkQueueSubmit(uploadBatch->transferQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // acquire barriers start at top of pipe, they must wait for the whole transfer
+            VkSubmitInfo acquireSubmitInfo{};
+            acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireSubmitInfo.pNext = &timelineSubmitInfo;
+            acquireSubmitInfo.waitSemaphoreCount = 1;
+            acquireSubmitInfo.pWaitSemaphores = &uploadBatch->transferCompleteSemaphore;
+            acquireSubmitInfo.pWaitDstStageMask = &waitStage;
+            acquireSubmitInfo.commandBufferCount = 1;
+            acquireSubmitInfo.pCommandBuffers = &uploadBatch->commandBuffer;
+            acquireSubmitInfo.signalSemaphoreCount = 1;
+            acquireSubmitInfo.pSignalSemaphores = &uploadBatch->timeline->semaphore;
+
+            if (vkQueueSubmit(uploadBatch->graphicsQueue, 1, &acquireSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+        }
+        else {
+            VkCommandBuffer commandBuffers[] = { uploadBatch->transferCommandBuffer, uploadBatch->commandBuffer };
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = &timelineSubmitInfo;
+            submitInfo.commandBufferCount = 2;
+            submitInfo.pCommandBuffers = commandBuffers;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &uploadBatch->timeline->semaphore;
+
+            if (vkQueueSubmit(uploadBatch->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload command buffer!");
+            }
+        }
+        stagingRingBuffer->markSubmitted(uploadBatch->timelineValue);
+        uploadBatch->recording = false;
+    }
+
+    // copy data into the staging ring, flushes the batch if its own pending uploads fill the ring
+    VkDeviceSize stageUploadData(const void* data, VkDeviceSize size, UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer, VkDevice* device) {
+        VkDeviceSize stagingOffset;
+        void* stagingData = stagingRingBuffer->allocate(size, &stagingOffset, uploadBatch->timeline, *device);
+        if (stagingData == nullptr) {
+            submitUploadBatch(uploadBatch, stagingRingBuffer);
+            beginUploadBatch(uploadBatch, stagingRingBuffer, device);
+            stagingData = stagingRingBuffer->allocate(size, &stagingOffset, uploadBatch->timeline, *device);
+            if (stagingData == nullptr) {
+                throw std::runtime_error("failed to allocate staging memory, the staging ring buffer is still blocked after submitting the upload batch!");
+            }
+        }
+        memcpy(stagingData, data, static_cast<size_t>(size));
+        return stagingOffset;
+    }
+
+    // make an uploaded buffer visible to the graphics queue: with a dedicated transfer queue the transfer queue releases
+    // and the graphics queue acquires ownership, otherwise a single barrier suffices
+    void releaseBufferToGraphicsQueue(UploadBatch* uploadBatch, VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStage) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        if (!uploadBatch->usesTransferQueue()) {
+            vkCmdPipelineBarrier(uploadBatch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+            return;
+        }
+
+        // the transfer queue does not support the stages the buffer is read in, dst access and stage are ignored on release
+        barrier.srcQueueFamilyIndex = uploadBatch->transferQueueFamily;
+        barrier.dstQueueFamilyIndex = uploadBatch->graphicsQueueFamily;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(uploadBatch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        // src access is ignored on acquire, the semaphore already made the copy available
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccessMask;
+        vkCmdPipelineBarrier(uploadBatch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    // same as releaseBufferToGraphicsQueue, release and acquire barriers have to specify the same layout transition
+    void releaseImageToGraphicsQueue(UploadBatch* uploadBatch, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStage) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        if (!uploadBatch->usesTransferQueue()) {
+            vkCmdPipelineBarrier(uploadBatch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            return;
+        }
+
+        barrier.srcQueueFamilyIndex = uploadBatch->transferQueueFamily;
+        barrier.dstQueueFamilyIndex = uploadBatch->graphicsQueueFamily;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(uploadBatch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccessMask;
+        vkCmdPipelineBarrier(uploadBatch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // recorded into the upload batch, see releaseBufferToGraphicsQueue for making the copy visible to draws
+    void copyBuffer(VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize size, VkCommandBuffer commandBuffer) {
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = 0; // Optional
+        copyRegion.size = size; //  It is not possible to specify VK_WHOLE_SIZE here, unlike the vkMapMemory command.
+        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    }
+
+    // Returns false with buffer set to VK_NULL_HANDLE if the allocator throttled the allocation of a streamed category
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkBuffer* buffer, MemoryAllocation* bufferAllocation, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage; //  indicates for which purposes the data in the buffer is going to be used
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffers can also be owned by specific wqueue family or shared between multiple at the same time
+        bufferInfo.flags = 0;
+
+        if (vkCreateBuffer(*device, &bufferInfo, hostAllocator, buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create vertex buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        // size: The size of the required amount of memory in bytes, may differ from bufferInfo.size.
+        // alignment: The offset in bytes where the buffer begins in the allocated region of memory, depends on bufferInfo.usage and bufferInfo.flags.
+        // memoryTypeBits : Bit field of the memory types that are suitable for the buffer.
+        vkGetBufferMemoryRequirements(*device, *buffer, &memRequirements);
+
+        // sub-allocate from a shared memory block instead of calling vkAllocateMemory for every buffer
+        uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
+        *bufferAllocation = deviceMemoryAllocator->allocate(memRequirements, memoryTypeIndex, false, category, *device);
+        if (bufferAllocation->memory == VK_NULL_HANDLE) {
+            vkDestroyBuffer(*device, *buffer, hostAllocator);
+            *buffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        vkBindBufferMemory(*device, *buffer, bufferAllocation->memory, bufferAllocation->offset);
+        return true;
+    }
+
+    // All uploads are staged through one persistently mapped buffer instead of a temporary staging buffer per upload
+    void createStagingRingBuffer(StagingRingBuffer* stagingRingBuffer, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(*physicalDevice, &properties);
+
+        stagingRingBuffer->size = StagingRingBuffer::DEFAULT_SIZE;
+        stagingRingBuffer->offsetAlignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+        createBuffer(stagingRingBuffer->size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, &stagingRingBuffer->buffer, &stagingRingBuffer->allocation, deviceMemoryAllocator, device, physicalDevice);
+    }
+
+    // one persistently mapped buffer per frame in flight holds the shared uniform data and the data of all objects
+    void createUniformBuffers(std::vector<void*>* uniformBuffersMapped, std::vector<MemoryAllocation>* uniformBuffersAllocations, std::vector<VkBuffer>* uniformBuffers, VkDeviceSize* objectUniformStride, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(*physicalDevice, &properties);
+
+        // dynamic offsets must be multiples of minUniformBufferOffsetAlignment, which is a power of two
+        VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+        *objectUniformStride = (sizeof(ObjectUniformData) + alignment - 1) & ~(alignment - 1);
+        VkDeviceSize bufferSize = getObjectUniformOffset(*objectUniformStride) + sceneObjectCount * *objectUniformStride;
+        // create uniform buffers for as many frames in flight to prevent writing into a buffer that is currently being read
+        uniformBuffers->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersAllocations->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersMapped->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_UNIFORMS, &uniformBuffers->at(i), &uniformBuffersAllocations->at(i), deviceMemoryAllocator, device, physicalDevice);
+            // persist mapping for the lifetime of the application to increase performance, the allocator keeps host visible blocks mapped
+            uniformBuffersMapped->at(i) = uniformBuffersAllocations->at(i).mapped;
+        }
+    }
+
+    // One persistently mapped instance buffer per frame in flight, read through vertex binding 1. The scene objects are written every frame,
+    // the additional instances of benchmarkInstancing are filled once, on a dense grid that fits into the view.
+    void createInstanceBuffers(std::vector<void*>* instanceBuffersMapped, std::vector<MemoryAllocation>* instanceBuffersAllocations, std::vector<VkBuffer>* instanceBuffers, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        uint32_t instanceCapacity = benchmarkInstancing ? std::max(sceneObjectCount, InstancingBenchmark::MAX_INSTANCES) : sceneObjectCount;
+        VkDeviceSize bufferSize = instanceCapacity * sizeof(ObjectUniformData);
+
+        std::vector<ObjectUniformData> benchmarkInstances(instanceCapacity - sceneObjectCount);
+        uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCapacity))));
+        float spacing = 4.0f / gridSize;
+        for (uint32_t i = 0; i < benchmarkInstances.size(); i++) {
+            uint32_t instance = sceneObjectCount + i;
+            glm::vec3 position((instance % gridSize - (gridSize - 1) * 0.5f) * spacing, (instance / gridSize - (gridSize - 1) * 0.5f) * spacing, 0.0f);
+            benchmarkInstances[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing * 0.5f));
+            benchmarkInstances[i].materialColor = glm::vec4(1.0f);
+        }
+
+        instanceBuffers->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        instanceBuffersAllocations->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        instanceBuffersMapped->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
+            // the culling shader reads the model matrices as storage buffer
+            if (!createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_MESHES, &instanceBuffers->at(i), &instanceBuffersAllocations->at(i), deviceMemoryAllocator, device, physicalDevice)) {
+                throw std::runtime_error("failed to create instance buffer, the memory budget is exhausted!");
+            }
+            instanceBuffersMapped->at(i) = instanceBuffersAllocations->at(i).mapped;
+            if (!benchmarkInstances.empty()) {
+                memcpy(static_cast<ObjectUniformData*>(instanceBuffersMapped->at(i)) + sceneObjectCount, benchmarkInstances.data(), benchmarkInstances.size() * sizeof(ObjectUniformData));
+            }
+        }
+    }
+
+    // Buffers and descriptor sets of useGpuCulling, the descriptor set layout comes with the culling pipeline
+    void createFrustumCulling(FrustumCulling* frustumCulling, const glm::vec4& boundingSphere, std::vector<VkBuffer>* uniformBuffers, std::vector<VkBuffer>* instanceBuffers, DeviceCapabilities* deviceCapabilities, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        frustumCulling->parameters.boundingSphere = boundingSphere;
+        frustumCulling->parameters.objectCount = sceneObjectCount;
+        frustumCulling->parameters.indexCount = static_cast<uint32_t>(indices.size());
+        frustumCulling->parameters.occlusionCulling = useOcclusionCulling;
+
+        // the culling shader writes up to one draw per object, the CPU fallback a single instanced draw
+        bool cullOnGpu = deviceCapabilities->drawIndirectCount;
+        VkDeviceSize indirectBufferSize = (cullOnGpu ? sceneObjectCount : 1) * sizeof(VkDrawIndexedIndirectCommand);
+        frustumCulling->indirectBuffers.resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        frustumCulling->indirectBuffersAllocations.resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
+            if (cullOnGpu) {
+                if (!createBuffer(indirectBufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_MESHES, &frustumCulling->indirectBuffers[i], &frustumCulling->indirectBuffersAllocations[i], deviceMemoryAllocator, device, physicalDevice)) {
+                    throw std::runtime_error("failed to create indirect draw buffer, the memory budget is exhausted!");
+                }
+            }
+            else {
+                if (!createBuffer(indirectBufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_MESHES, &frustumCulling->indirectBuffers[i], &frustumCulling->indirectBuffersAllocations[i], deviceMemoryAllocator, device, physicalDevice)) {
+                    throw std::runtime_error("failed to create indirect draw buffer, the memory budget is exhausted!");
+                }
+            }
+        }
+        if (!cullOnGpu) {
+            return;
+        }
+
+        // the draw count is reset with vkCmdFillBuffer before culling
+        frustumCulling->drawCountBuffers.resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        frustumCulling->drawCountBuffersAllocations.resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
+            if (!createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_MESHES, &frustumCulling->drawCountBuffers[i], &frustumCulling->drawCountBuffersAllocations[i], deviceMemoryAllocator, device, physicalDevice)) {
+                throw std::runtime_error("failed to create draw count buffer, the memory budget is exhausted!");
+            }
+        }
+
+        std::array<VkDescriptorPoolSize, 3> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT) * 3; // objects, draws and draw count
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[2].descriptorCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT); // depth pyramid
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);
 
-    }
-    
-    // helper function, contents may be recorded into setup buffer and flused as single commandbuffer
-    VkCommandBuffer beginSingleTimeCommands(VkCommandPool* commandPool, VkDevice* device) {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = *commandPool;
-        allocInfo.commandBufferCount = 1;
+        if (vkCreateDescriptorPool(*device, &poolInfo, hostAllocator, &frustumCulling->descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor pool!");
+        }
 
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(*device, &allocInfo, &commandBuffer);
+        std::vector<VkDescriptorSetLayout> layouts(GVEProject::MAX_FRAMES_IN_FLIGHT, frustumCulling->descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = frustumCulling->descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
 
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        frustumCulling->descriptorSets.resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(*device, &allocInfo, frustumCulling->descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate culling descriptor sets!");
+        }
 
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
+            // view and projection of the frame, the object data written by updateUniformBuffer and the draws appended by the shader
+            std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+            bufferInfos[0] = { uniformBuffers->at(i), 0, sizeof(UniformBufferObject) };
+            bufferInfos[1] = { instanceBuffers->at(i), 0, sceneObjectCount * sizeof(ObjectUniformData) };
+            bufferInfos[2] = { frustumCulling->indirectBuffers[i], 0, VK_WHOLE_SIZE };
+            bufferInfos[3] = { frustumCulling->drawCountBuffers[i], 0, VK_WHOLE_SIZE };
+
+            std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+            for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = frustumCulling->descriptorSets[i];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
 
-        return commandBuffer;
+            vkUpdateDescriptorSets(*device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+        updateDepthPyramidDescriptors(frustumCulling, device);
     }
 
-    // helper function, contents may be recorded into setup buffer and flused as single commandbuffer
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device) {
-        vkEndCommandBuffer(commandBuffer);
+    // Depth pyramid of useGpuCulling, cleared to the far plane with the upload batch so the first frames are not occluded.
+    // The reduction descriptors read the depth attachment for level 0 and the level above for every further level.
+    void createDepthPyramid(DepthPyramid* depthPyramid, VkImage* depthImage, VkImageView* depthImageView, UploadBatch* uploadBatch, DeviceMemoryAllocator* deviceMemoryAllocator, VkExtent2D* swapChainExtent, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        if (depthPyramid->sampler == VK_NULL_HANDLE) {
+            // texels are fetched and compared, never filtered
+            VkSamplerCreateInfo samplerInfo{};
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_NEAREST;
+            samplerInfo.minFilter = VK_FILTER_NEAREST;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.minLod = 0.0f;
+            samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+            if (vkCreateSampler(*device, &samplerInfo, hostAllocator, &depthPyramid->sampler) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid sampler!");
+            }
+        }
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
+        VkFormat depthFormat = findDepthFormat(physicalDevice);
+        depthPyramid->depthImage = *depthImage;
+        depthPyramid->depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencilComponent(depthFormat) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+        // power of two below the attachment size, so every level halves the one above
+        auto previousPowerOfTwo = [](uint32_t value) {
+            uint32_t powerOfTwo = 1;
+            while (powerOfTwo * 2 <= value) {
+                powerOfTwo *= 2;
+            }
+            return powerOfTwo;
+        };
+        depthPyramid->extent = useOcclusionCulling ? VkExtent2D{ previousPowerOfTwo(swapChainExtent->width), previousPowerOfTwo(swapChainExtent->height) } : VkExtent2D{ 1, 1 };
+        depthPyramid->levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(depthPyramid->extent.width, depthPyramid->extent.height)))) + 1;
+
+        createImage(depthPyramid->extent.width, depthPyramid->extent.height, depthPyramid->levelCount, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENTS, depthPyramid->image, depthPyramid->allocation, deviceMemoryAllocator, device, physicalDevice);
+
+        auto createLevelsView = [&](uint32_t baseLevel, uint32_t levelCount) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = depthPyramid->image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = VK_FORMAT_R32_SFLOAT;
+            viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1 };
+
+            VkImageView imageView;
+            if (vkCreateImageView(*device, &viewInfo, hostAllocator, &imageView) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid image view!");
+            }
+            return imageView;
+        };
+        depthPyramid->view = createLevelsView(0, depthPyramid->levelCount);
+        depthPyramid->levelViews.resize(depthPyramid->levelCount);
+        for (uint32_t level = 0; level < depthPyramid->levelCount; level++) {
+            depthPyramid->levelViews[level] = createLevelsView(level, 1);
+        }
 
-        vkQueueSubmit(*graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(*graphicsQueue);
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = depthPyramid->image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid->levelCount, 0, 1 };
+        vkCmdPipelineBarrier(uploadBatch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-        vkFreeCommandBuffers(*device, *commandPool, 1, &commandBuffer);
-    }
+        VkClearColorValue farPlane = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+        vkCmdClearColorImage(uploadBatch->commandBuffer, depthPyramid->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &farPlane, 1, &barrier.subresourceRange);
 
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        vkCmdPipelineBarrier(uploadBatch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(commandPool, device);
+        if (depthPyramid->pipeline == VK_NULL_HANDLE) {
+            return;
+        }
 
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0; // Optional
-        copyRegion.dstOffset = 0; // Optional
-        copyRegion.size = size; //  It is not possible to specify VK_WHOLE_SIZE here, unlike the vkMapMemory command.
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-        
-        endSingleTimeCommands(commandBuffer, commandPool, graphicsQueue, device);
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = depthPyramid->levelCount;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[1].descriptorCount = depthPyramid->levelCount;
 
-    }
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = depthPyramid->levelCount;
 
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, VkDeviceMemory* bufferMemory, VkDevice* device, VkPhysicalDevice* physicalDevice) {
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = size;
-        bufferInfo.usage = usage; //  indicates for which purposes the data in the buffer is going to be used
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffers can also be owned by specific wqueue family or shared between multiple at the same time
-        bufferInfo.flags = 0;
+        if (vkCreateDescriptorPool(*device, &poolInfo, hostAllocator, &depthPyramid->descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+        }
 
-        if (vkCreateBuffer(*device, &bufferInfo, nullptr, buffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create vertex buffer!");
+        std::vector<VkDescriptorSetLayout> layouts(depthPyramid->levelCount, depthPyramid->descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = depthPyramid->descriptorPool;
+        allocInfo.descriptorSetCount = depthPyramid->levelCount;
+        allocInfo.pSetLayouts = layouts.data();
+
+        depthPyramid->descriptorSets.resize(depthPyramid->levelCount);
+        if (vkAllocateDescriptorSets(*device, &allocInfo, depthPyramid->descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
         }
 
-        VkMemoryRequirements memRequirements;
-        // size: The size of the required amount of memory in bytes, may differ from bufferInfo.size.
-        // alignment: The offset in bytes where the buffer begins in the allocated region of memory, depends on bufferInfo.usage and bufferInfo.flags.
-        // memoryTypeBits : Bit field of the memory types that are suitable for the buffer.
-        vkGetBufferMemoryRequirements(*device, *buffer, &memRequirements);
+        for (uint32_t level = 0; level < depthPyramid->levelCount; level++) {
+            // the depth attachment is read only during the reduction, see recordDepthPyramidReduction
+            VkDescriptorImageInfo inputInfo{};
+            inputInfo.sampler = depthPyramid->sampler;
+            inputInfo.imageView = level == 0 ? *depthImageView : depthPyramid->levelViews[level - 1];
+            inputInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
+            VkDescriptorImageInfo outputInfo{};
+            outputInfo.imageView = depthPyramid->levelViews[level];
+            outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
-        // Don't call vkAllicateMemory for every buffer:
-        // check out https://github.com/GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator 
-        if (vkAllocateMemory(*device, &allocInfo, nullptr, bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
-        }
+            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = depthPyramid->descriptorSets[level];
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pImageInfo = binding == 0 ? &inputInfo : &outputInfo;
+            }
 
-        vkBindBufferMemory(*device, *buffer, *bufferMemory, 0);
+            vkUpdateDescriptorSets(*device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
     }
 
-    void createUniformBuffers(std::vector<void*>* uniformBuffersMapped, std::vector<VkDeviceMemory>* uniformBuffersMemory, std::vector<VkBuffer>* uniformBuffers, VkDevice* device, VkPhysicalDevice* physicalDevice) {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-        // create uniform buffers for as many frames in flight to prevent writing into a buffer that is currently being read
-        uniformBuffers->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMapped->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
-
-        for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffers->at(i), &uniformBuffersMemory->at(i), device, physicalDevice);
-            // persist mapping for the lifetime of the application to increase performance
-            vkMapMemory(*device, uniformBuffersMemory->at(i), 0, bufferSize, 0, &uniformBuffersMapped->at(i));
+    // bind the depth pyramid to the culling descriptor sets, again whenever it was recreated with the swapchain
+    void updateDepthPyramidDescriptors(FrustumCulling* frustumCulling, VkDevice* device) {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler = frustumCulling->depthPyramid.sampler;
+        imageInfo.imageView = frustumCulling->depthPyramid.view;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::vector<VkWriteDescriptorSet> descriptorWrites(frustumCulling->descriptorSets.size());
+        for (size_t i = 0; i < descriptorWrites.size(); i++) {
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = frustumCulling->descriptorSets[i];
+            descriptorWrites[i].dstBinding = 4;
+            descriptorWrites[i].dstArrayElement = 0;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[i].descriptorCount = 1;
+            descriptorWrites[i].pImageInfo = &imageInfo;
         }
+
+        vkUpdateDescriptorSets(*device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 
-    void createIndexBuffer(VkDeviceMemory* indexBufferMemory, VkBuffer* indexBuffer, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    void createIndexBuffer(MemoryAllocation* indexBufferAllocation, VkBuffer* indexBuffer, UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
         VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
         //upload cpu buffer (host visible) into gpu buffer (device local) 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, device, physicalDevice);
+        VkDeviceSize stagingOffset = stageUploadData(indices.data(), bufferSize, uploadBatch, stagingRingBuffer, device); //copy contents of buffer into accessible field
 
-        // access a region of the specified memory resource defined by an offset and size, use VK_WHOLE_SIZE to map all of the memory
-        void* data;
-        vkMapMemory(*device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t)bufferSize); //copy contents of buffer into accessible field
-        vkUnmapMemory(*device, stagingBufferMemory);
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, device, physicalDevice);
-
-        copyBuffer(stagingBuffer, *indexBuffer, bufferSize, commandPool, graphicsQueue, device);
+        if (!createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_MESHES, indexBuffer, indexBufferAllocation, deviceMemoryAllocator, device, physicalDevice)) {
+            throw std::runtime_error("failed to create index buffer, the memory budget is exhausted!");
+        }
 
-        vkDestroyBuffer(*device, stagingBuffer, nullptr);
-        vkFreeMemory(*device, stagingBufferMemory, nullptr);
+        copyBuffer(stagingRingBuffer->buffer, stagingOffset, *indexBuffer, bufferSize, uploadBatch->transferCommandBuffer);
+        releaseBufferToGraphicsQueue(uploadBatch, *indexBuffer, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
     }
 
-    void createVertexBuffer(VkDeviceMemory* vertexBufferMemory, VkBuffer* vertexBuffer, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    void createVertexBuffer(MemoryAllocation* vertexBufferAllocation, VkBuffer* vertexBuffer, UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
         //upload cpu buffer (host visible) into gpu buffer (device local) 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
+        VkDeviceSize stagingOffset = stageUploadData(vertices.data(), bufferSize, uploadBatch, stagingRingBuffer, device); //copy contents of buffer into accessible field
+
+        if (!createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_MESHES, vertexBuffer, vertexBufferAllocation, deviceMemoryAllocator, device, physicalDevice)) {
+            throw std::runtime_error("failed to create vertex buffer, the memory budget is exhausted!");
+        }
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, device, physicalDevice);
+        copyBuffer(stagingRingBuffer->buffer, stagingOffset, *vertexBuffer, bufferSize, uploadBatch->transferCommandBuffer);
+        releaseBufferToGraphicsQueue(uploadBatch, *vertexBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    }
 
-        // access a region of the specified memory resource defined by an offset and size, use VK_WHOLE_SIZE to map all of the memory
-        void* data;
-        vkMapMemory(*device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t)bufferSize); //copy contents of buffer into accessible field
-        vkUnmapMemory(*device, stagingBufferMemory);
+    // Vertex positions of useDepthPrePass without color and texture coordinates, the pre-pass fetches 12 instead of 32 bytes per vertex
+    void createPositionBuffer(MemoryAllocation* positionBufferAllocation, VkBuffer* positionBuffer, UploadBatch* uploadBatch, StagingRingBuffer* stagingRingBuffer, DeviceMemoryAllocator* deviceMemoryAllocator, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            positions[i] = vertices[i].pos;
+        }
+        VkDeviceSize bufferSize = sizeof(positions[0]) * positions.size();
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, device, physicalDevice);
+        VkDeviceSize stagingOffset = stageUploadData(positions.data(), bufferSize, uploadBatch, stagingRingBuffer, device);
 
-        copyBuffer(stagingBuffer, *vertexBuffer, bufferSize, commandPool, graphicsQueue, device);
+        if (!createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_MESHES, positionBuffer, positionBufferAllocation, deviceMemoryAllocator, device, physicalDevice)) {
+            throw std::runtime_error("failed to create position buffer, the memory budget is exhausted!");
+        }
 
-        vkDestroyBuffer(*device, stagingBuffer, nullptr);
-        vkFreeMemory(*device, stagingBufferMemory, nullptr);
+        copyBuffer(stagingRingBuffer->buffer, stagingOffset, *positionBuffer, bufferSize, uploadBatch->transferCommandBuffer);
+        releaseBufferToGraphicsQueue(uploadBatch, *positionBuffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
     }
      
     // setup layout transitions to copy buffers into images 
-    // helper function, contents may be recorded into setup buffer and flused as single commandbuffer
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandPool* commandPool, VkQueue* graphicsQueue, VkDevice* device) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(commandPool, device);
+    // recorded into the upload batch, see beginUploadBatch
+    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer commandBuffer) {
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -839,51 +2954,386 @@ private:
             0, nullptr, // array reference of barriers of types memory barriers, buffer memory barriers or image barriers
             1, &barrier
         );
-
-        endSingleTimeCommands(commandBuffer, commandPool, graphicsQueue, device);
     }
 
-    void createSyncObjects(std::vector<VkSemaphore>* imageAvailableSemaphores, std::vector<VkSemaphore>* renderFinishedSemaphores, std::vector<VkFence>* inFlightFences, VkDevice* device) {
+    // Instead of a fence per frame, each frame waits on the GpuTimeline for the value its frame in flight signaled last.
+    // Binary semaphores are still needed for the swapchain, acquiring and presenting images does not support timeline semaphores.
+    void createSyncObjects(std::vector<VkSemaphore>* imageAvailableSemaphores, std::vector<VkSemaphore>* renderFinishedSemaphores, std::vector<uint64_t>* frameTimelineValues, VkDevice* device) {
         imageAvailableSemaphores->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
-        inFlightFences->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        frameTimelineValues->assign(GVEProject::MAX_FRAMES_IN_FLIGHT, 0); // 0 is reached from the start, the first frames don't wait
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // set signaled to prevent infinite waiting loop on first frame
-
         for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
-            if (vkCreateSemaphore(*device, &semaphoreInfo, nullptr, &imageAvailableSemaphores->at(i)) != VK_SUCCESS ||
-                vkCreateSemaphore(*device, &semaphoreInfo, nullptr, &renderFinishedSemaphores->at(i)) != VK_SUCCESS ||
-                vkCreateFence(*device, &fenceInfo, nullptr, &inFlightFences->at(i)) != VK_SUCCESS) {
+            if (vkCreateSemaphore(*device, &semaphoreInfo, hostAllocator, &imageAvailableSemaphores->at(i)) != VK_SUCCESS ||
+                vkCreateSemaphore(*device, &semaphoreInfo, hostAllocator, &renderFinishedSemaphores->at(i)) != VK_SUCCESS) {
 
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
         }
     }
 
-    void createCommandBuffers(std::vector<VkCommandBuffer>* commandBuffers, VkCommandPool* commandPool, VkDevice* device) {
+    void createGpuTimeline(GpuTimeline* gpuTimeline, VkDevice* device) {
+        VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo{};
+        semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        semaphoreTypeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &semaphoreTypeInfo;
+
+        if (vkCreateSemaphore(*device, &semaphoreInfo, hostAllocator, &gpuTimeline->semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timeline semaphore!");
+        }
+
+        // the core commands are only returned for Vulkan 1.2 devices, the extension commands only if the extension is enabled
+        gpuTimeline->vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(*device, "vkWaitSemaphores");
+        gpuTimeline->vkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(*device, "vkGetSemaphoreCounterValue");
+        if (gpuTimeline->vkWaitSemaphoresKHR == nullptr || gpuTimeline->vkGetSemaphoreCounterValueKHR == nullptr) {
+            gpuTimeline->vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(*device, "vkWaitSemaphoresKHR");
+            gpuTimeline->vkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(*device, "vkGetSemaphoreCounterValueKHR");
+        }
+    }
+
+    // the command buffer of each frame in flight is allocated from the pool of the first recording thread of that frame
+    void createCommandBuffers(std::vector<VkCommandBuffer>* commandBuffers, std::vector<std::vector<VkCommandPool>>* frameCommandPools, VkDevice* device) {
         commandBuffers->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
 
-        // The level parameter specifies if the allocated command buffers are primary or secondary command buffers.
-        // VK_COMMAND_BUFFER_LEVEL_PRIMARY: Can be submitted to a queue for execution, but cannot be called from other command buffers.
-        // VK_COMMAND_BUFFER_LEVEL_SECONDARY : Cannot be submitted directly, but can be called from primary command buffers.
+        for (size_t frame = 0; frame < commandBuffers->size(); frame++) {
+            // The level parameter specifies if the allocated command buffers are primary or secondary command buffers.
+            // VK_COMMAND_BUFFER_LEVEL_PRIMARY: Can be submitted to a queue for execution, but cannot be called from other command buffers.
+            // VK_COMMAND_BUFFER_LEVEL_SECONDARY : Cannot be submitted directly, but can be called from primary command buffers.
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = frameCommandPools->at(frame).at(0);
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; //use secondary to e.g. reuse common opertations from primary command buffers
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(*device, &allocInfo, &commandBuffers->at(frame)) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+    }
+
+    // Reset all command buffers of a frame in flight at once, the frame's timeline value must have been waited for.
+    // Resetting whole pools lets the driver recycle the command memory in bulk instead of tracking every command buffer on its own.
+    void resetFrameCommandPools(std::vector<VkCommandPool>* framePools, VkDevice* device) {
+        for (VkCommandPool pool : *framePools) {
+            vkResetCommandPool(*device, pool, 0);
+        }
+    }
+
+    // (Re)allocate the cached command buffers for the current swapchain images, all of them are recorded on first use.
+    // Called after swapchain recreation as the number of images and the framebuffers may have changed, the device must be idle.
+    void createCommandBufferCache(CommandBufferCache* commandBufferCache, uint32_t imageCount, VkCommandPool* commandPool, VkDevice* device) {
+        if (!commandBufferCache->commandBuffers.empty()) {
+            vkFreeCommandBuffers(*device, *commandPool, static_cast<uint32_t>(commandBufferCache->commandBuffers.size()), commandBufferCache->commandBuffers.data());
+        }
+
+        commandBufferCache->imageCount = imageCount;
+        commandBufferCache->commandBuffers.resize(GVEProject::MAX_FRAMES_IN_FLIGHT * imageCount);
+        commandBufferCache->dirty.assign(commandBufferCache->commandBuffers.size(), true);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = *commandPool; // allows resetting single command buffers for re-recording
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBufferCache->commandBuffers.size());
+
+        if (vkAllocateCommandBuffers(*device, &allocInfo, commandBufferCache->commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate cached command buffers!");
+        }
+    }
+
+    // one secondary command buffer per recording thread and frame in flight, each allocated from the command pool of its thread
+    void createSecondaryCommandBuffers(std::vector<std::vector<VkCommandBuffer>>* secondaryCommandBuffers, std::vector<std::vector<VkCommandPool>>* frameCommandPools, VkDevice* device) {
+        secondaryCommandBuffers->resize(frameCommandPools->size());
+        for (size_t frame = 0; frame < frameCommandPools->size(); frame++) {
+            secondaryCommandBuffers->at(frame).resize(frameCommandPools->at(frame).size());
+            for (size_t thread = 0; thread < frameCommandPools->at(frame).size(); thread++) {
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = frameCommandPools->at(frame).at(thread);
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandBufferCount = 1;
+
+                if (vkAllocateCommandBuffers(*device, &allocInfo, &secondaryCommandBuffers->at(frame).at(thread)) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate secondary command buffers!");
+                }
+            }
+        }
+    }
+
+    // Pipeline entries sharing a pipeline are drawn with the pipeline still bound, binding it again would only cost CPU and driver time
+    void bindPipelineIfChanged(VkCommandBuffer* commandBuffer, VkPipeline pipeline, VkPipeline* boundPipeline) {
+        if (pipeline != *boundPipeline) {
+            vkCmdBindPipeline(*commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            *boundPipeline = pipeline;
+        }
+    }
+
+    // Set the fixed function state of a pipeline entry that was created as dynamic state, see setupFixedFunctionStage
+    void setDynamicPipelineState(VkCommandBuffer* commandBuffer, const GVEProject::FixedFunctionStageParameters& pipelineParameters, DeviceCapabilities* deviceCapabilities) {
+        vkCmdSetLineWidth(*commandBuffer, deviceCapabilities->wideLines ? pipelineParameters.rasterizerInfo_lineWidth : 1.0f);
+        vkCmdSetDepthBias(*commandBuffer, pipelineParameters.rasterizerInfo_depthBiasConstantFactor, pipelineParameters.rasterizerInfo_depthBiasClamp, pipelineParameters.rasterizerInfo_depthBiasSlopeFactor);
+        vkCmdSetDepthBounds(*commandBuffer, pipelineParameters.depthStencilInfo_minDepthBounds, pipelineParameters.depthStencilInfo_maxDepthBounds);
+        const float blendConstants[4] = { pipelineParameters.colorBlendingInfo_blendConstants_0, pipelineParameters.colorBlendingInfo_blendConstants_1, pipelineParameters.colorBlendingInfo_blendConstants_2, pipelineParameters.colorBlendingInfo_blendConstants_3 };
+        vkCmdSetBlendConstants(*commandBuffer, blendConstants);
+
+        if (deviceCapabilities->extendedDynamicState) {
+            deviceCapabilities->vkCmdSetCullModeEXT(*commandBuffer, pipelineParameters.rasterizerInfo_cullMode);
+            deviceCapabilities->vkCmdSetFrontFaceEXT(*commandBuffer, pipelineParameters.rasterizerInfo_frontFace);
+            deviceCapabilities->vkCmdSetPrimitiveTopologyEXT(*commandBuffer, pipelineParameters.inputAssemblyInfo_topology);
+            deviceCapabilities->vkCmdSetDepthTestEnableEXT(*commandBuffer, pipelineParameters.depthStencilInfo_depthTestEnable);
+            deviceCapabilities->vkCmdSetDepthWriteEnableEXT(*commandBuffer, pipelineParameters.depthStencilInfo_depthWriteEnable);
+            deviceCapabilities->vkCmdSetDepthCompareOpEXT(*commandBuffer, pipelineParameters.depthStencilInfo_depthCompareOp);
+            deviceCapabilities->vkCmdSetDepthBoundsTestEnableEXT(*commandBuffer, pipelineParameters.depthStencilInfo_depthBoundsTestEnable);
+            deviceCapabilities->vkCmdSetStencilTestEnableEXT(*commandBuffer, pipelineParameters.depthStencilInfo_stencilTestEnable);
+        }
+        if (deviceCapabilities->extendedDynamicState2) {
+            deviceCapabilities->vkCmdSetDepthBiasEnableEXT(*commandBuffer, pipelineParameters.rasterizerInfo_depthBiasEnable);
+            deviceCapabilities->vkCmdSetPrimitiveRestartEnableEXT(*commandBuffer, pipelineParameters.inputAssemblyInfo_primitiveRestartEnable);
+            deviceCapabilities->vkCmdSetRasterizerDiscardEnableEXT(*commandBuffer, pipelineParameters.rasterizerInfo_rasterizerDiscardEnable);
+        }
+        if (deviceCapabilities->extendedDynamicState3PolygonMode) {
+            deviceCapabilities->vkCmdSetPolygonModeEXT(*commandBuffer, pipelineParameters.rasterizerInfo_polygonMode);
+        }
+        if (deviceCapabilities->extendedDynamicState3ColorBlend) {
+            VkBool32 blendEnable = pipelineParameters.colorBlendAttachment_blendEnable;
+            VkColorBlendEquationEXT blendEquation{};
+            blendEquation.srcColorBlendFactor = pipelineParameters.colorBlendAttachment_srcColorBlendFactor;
+            blendEquation.dstColorBlendFactor = pipelineParameters.colorBlendAttachment_dstColorBlendFactor;
+            blendEquation.colorBlendOp = pipelineParameters.colorBlendAttachment_colorBlendOp;
+            blendEquation.srcAlphaBlendFactor = pipelineParameters.colorBlendAttachment_srcAlphaBlendFactor;
+            blendEquation.dstAlphaBlendFactor = pipelineParameters.colorBlendAttachment_dstAlphaBlendFactor;
+            blendEquation.alphaBlendOp = pipelineParameters.colorBlendAttachment_alphaBlendOp;
+            VkColorComponentFlags colorWriteMask = pipelineParameters.colorBlendAttachment_colorWriteMask;
+            deviceCapabilities->vkCmdSetColorBlendEnableEXT(*commandBuffer, 0, 1, &blendEnable);
+            deviceCapabilities->vkCmdSetColorBlendEquationEXT(*commandBuffer, 0, 1, &blendEquation);
+            deviceCapabilities->vkCmdSetColorWriteMaskEXT(*commandBuffer, 0, 1, &colorWriteMask);
+        }
+    }
+
+    // Begin the render pass in the subpass the scene pipelines are created for, the depth pre-pass subpass of useDepthPrePass is left empty
+    void beginSceneSubpass(VkCommandBuffer* commandBuffer, const VkRenderPassBeginInfo& renderPassInfo, VkSubpassContents contents) {
+        if (useDepthPrePass) {
+            vkCmdBeginRenderPass(*commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdNextSubpass(*commandBuffer, contents);
+        }
+        else {
+            vkCmdBeginRenderPass(*commandBuffer, &renderPassInfo, contents);
+        }
+    }
+
+    // rebinding the same set with another dynamic offset is all it takes to switch objects
+    void bindObjectDescriptorSet(VkCommandBuffer* commandBuffer, VkDescriptorSet descriptorSet, uint32_t objectIndex, VkDeviceSize objectUniformStride, VkPipelineLayout* pipelineLayout) {
+        uint32_t dynamicOffset = static_cast<uint32_t>(objectIndex * objectUniformStride);
+        vkCmdBindDescriptorSets(*commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+    }
+
+    // with push constants the descriptor set is bound once and only the object data changes between draws
+    void setObjectData(VkCommandBuffer* commandBuffer, VkDescriptorSet descriptorSet, uint32_t objectIndex, const std::vector<ObjectUniformData>* objectData, VkDeviceSize objectUniformStride, VkPipelineLayout* pipelineLayout) {
+        if (objectDataInPushConstants) {
+            vkCmdPushConstants(*commandBuffer, *pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ObjectUniformData), &objectData->at(objectIndex));
+        }
+        else {
+            bindObjectDescriptorSet(commandBuffer, descriptorSet, objectIndex, objectUniformStride, pipelineLayout);
+        }
+    }
+
+    // Measure recording draws whose object data is pushed against draws rebinding the descriptor set with the offset of their data in the
+    // uniform buffer, including the uniform writes. Only CPU time is measured, the command buffer is never submitted.
+    void benchmarkPerObjectDataPaths(std::vector<VkDescriptorSet>* descriptorSets, std::vector<void*>* uniformBuffersMapped, VkDeviceSize objectUniformStride, VkPipeline graphicsPipeline, VkRenderPass* renderPass, VkFramebuffer framebuffer, VkExtent2D* swapChainExtent, VkPipelineLayout* pipelineLayout, VkCommandPool* commandPool, VkDevice* device) {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = *commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; //use secondary to e.g. reuse common opertations from primary command buffers
-        allocInfo.commandBufferCount = (uint32_t)commandBuffers->size();
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(*device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate benchmark command buffer!");
+        }
+
+        ObjectUniformData object{};
+        object.model = glm::mat4(1.0f);
+        object.materialColor = glm::vec4(1.0f);
+        char* objectUniforms = static_cast<char*>(uniformBuffersMapped->at(0)) + getObjectUniformOffset(objectUniformStride);
+
+        auto measureMilliseconds = [&](uint32_t drawCount, bool pushConstants) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            auto startTime = std::chrono::high_resolution_clock::now();
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = *renderPass;
+            renderPassInfo.framebuffer = framebuffer;
+            renderPassInfo.renderArea.extent = *swapChainExtent;
+            beginSceneSubpass(&commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+            uint32_t noOffset = 0;
+            if (pushConstants) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipelineLayout, 0, 1, &descriptorSets->at(0), 1, &noOffset);
+            }
+            for (uint32_t i = 0; i < drawCount; i++) {
+                if (pushConstants) {
+                    vkCmdPushConstants(commandBuffer, *pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ObjectUniformData), &object);
+                }
+                else {
+                    // the uniform buffer only has room for the scene objects, draws beyond share their slots
+                    uint32_t slot = i % sceneObjectCount;
+                    memcpy(objectUniforms + slot * objectUniformStride, &object, sizeof(object));
+                    bindObjectDescriptorSet(&commandBuffer, descriptorSets->at(0), slot, objectUniformStride, pipelineLayout);
+                }
+                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+            }
+
+            vkCmdEndRenderPass(commandBuffer);
+            vkEndCommandBuffer(commandBuffer);
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        };
+
+        std::cout << "Per-object data benchmark (recording only):" << std::endl;
+        for (uint32_t drawCount : { 1000u, 10000u, 100000u }) {
+            std::cout << "	" << drawCount << " draws: uniform buffer offsets " << measureMilliseconds(drawCount, false) << " ms, push constants " << measureMilliseconds(drawCount, true) << " ms" << std::endl;
+        }
+
+        vkFreeCommandBuffers(*device, *commandPool, 1, &commandBuffer);
+    }
+
+    // Record the draws [firstDraw, firstDraw + drawCount) of the scene, draw d is object d % sceneObjectCount of pipeline entry d / sceneObjectCount.
+    // With useInstancing draw d is pipeline entry d instead, drawing instanceCount instances of the model at once.
+    // With useGpuCulling draw d is pipeline entry d as well, drawing the visible objects from the indirect buffer.
+    // With useCpuCulling only the visibleObjects are drawn, draw d is visible object d % visibleObjects->size() of pipeline entry d / visibleObjects->size().
+    // For the depth pre-pass the depth-only pipelines and the position buffer are passed as graphicsPipelines and vertexBuffer, only entries with hasDepthPrePass are drawn.
+    // The command buffer starts without any bound state, so buffers, viewport and scissor are set for every range.
+    void recordSceneDraws(VkCommandBuffer* commandBuffer, uint32_t firstDraw, uint32_t drawCount, uint32_t instanceCount, const std::vector<uint32_t>* visibleObjects, bool depthPrePass, VkDescriptorSet descriptorSet, const std::vector<ObjectUniformData>* objectData, VkDeviceSize objectUniformStride, VkBuffer* indexBuffer, VkBuffer* vertexBuffer, VkBuffer instanceBuffer, VkBuffer indirectBuffer, VkBuffer drawCountBuffer, std::vector<VkPipeline>* graphicsPipelines, std::vector<uint32_t>* graphicsPipelineIndices, DeviceCapabilities* deviceCapabilities, VkPipelineLayout* pipelineLayout, VkExtent2D* swapChainExtent) {
+        VkBuffer vertexBuffers[] = { *vertexBuffer, instanceBuffer };
+        VkDeviceSize offsets[] = { 0, 0 };
+        vkCmdBindVertexBuffers(*commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(*commandBuffer, *indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        // define dynamic states
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(swapChainExtent->width);
+        viewport.height = static_cast<float>(swapChainExtent->height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(*commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = *swapChainExtent;
+        vkCmdSetScissor(*commandBuffer, 0, 1, &scissor);
+
+        if (objectDataInPushConstants || objectDataInInstanceBuffer) {
+            bindObjectDescriptorSet(commandBuffer, descriptorSet, 0, objectUniformStride, pipelineLayout);
+        }
+
+        //actual draw command
+        // vertexCount
+        // instanceCount : Used for instanced rendering, use 1 if you're not doing that.
+        // firstVertex : Used as an offset into the vertex buffer, defines the lowest value of gl_VertexIndex.
+        // firstInstance : Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
+        //
+        // bind the pipeline of each pipeline entry to graphics and set the state of the entry that is not baked into the pipeline
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        size_t currentEntry = SIZE_MAX;
+        uint32_t objectCount = useCpuCulling ? static_cast<uint32_t>(visibleObjects->size()) : sceneObjectCount;
+        for (uint32_t draw = firstDraw; draw < firstDraw + drawCount; draw++) {
+            size_t entry = (objectDataInInstanceBuffer ? draw : draw / objectCount) % graphicsPipelineIndices->size();
+            const GVEProject::FixedFunctionStageParameters& pipelineParameters = GVEProject::PIPELINE_PARAMETERS[entry];
+            if (depthPrePass && !hasDepthPrePass(pipelineParameters)) {
+                continue;
+            }
+            if (entry != currentEntry) {
+                bindPipelineIfChanged(commandBuffer, graphicsPipelines->at(graphicsPipelineIndices->at(entry)), &boundPipeline);
+                setDynamicPipelineState(commandBuffer, pipelineParameters, deviceCapabilities);
+                // the pre-pass writes the depth with the compare op of the entry, the scene subpass only shades the fragments that won it
+                if (deviceCapabilities->extendedDynamicState && hasDepthPrePass(pipelineParameters)) {
+                    deviceCapabilities->vkCmdSetDepthWriteEnableEXT(*commandBuffer, depthPrePass ? VK_TRUE : VK_FALSE);
+                    deviceCapabilities->vkCmdSetDepthCompareOpEXT(*commandBuffer, depthPrePass ? pipelineParameters.depthStencilInfo_depthCompareOp : VK_COMPARE_OP_EQUAL);
+                }
+                currentEntry = entry;
+            }
+            if (!objectDataInInstanceBuffer) {
+                uint32_t objectIndex = useCpuCulling ? visibleObjects->at(draw % objectCount) : draw % objectCount;
+                setObjectData(commandBuffer, descriptorSet, objectIndex, objectData, objectUniformStride, pipelineLayout);
+            }
+            uint32_t drawInstanceCount = useInstancing ? instanceCount : 1;
 
-        if (vkAllocateCommandBuffers(*device, &allocInfo, commandBuffers->data()) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers!");
+            if (useGpuCulling) {
+                if (deviceCapabilities->drawIndirectCount) {
+                    // a draw of one instance per visible object, selecting the object data with firstInstance
+                    deviceCapabilities->vkCmdDrawIndexedIndirectCount(*commandBuffer, indirectBuffer, 0, drawCountBuffer, 0, sceneObjectCount, sizeof(VkDrawIndexedIndirectCommand));
+                }
+                else {
+                    // a single instanced draw of the visible objects packed by cullObjectsOnCpu
+                    vkCmdDrawIndexedIndirect(*commandBuffer, indirectBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+                }
+            }
+            else if constexpr (GVEProject::USE_INDEXED_VERTICES) {
+                // reuse vertices by using their indices and place them in order specified by "indices" array
+                // saves about 50% of memory for vertices
+                vkCmdDrawIndexed(*commandBuffer, static_cast<uint32_t>(indices.size()), drawInstanceCount, 0, 0, 0);
+            }
+            else {
+                // use non-indexed vertices
+                // make sure to add the correct amount of vertices for each primitive/triangle.
+                // --> three vertices for each triangle, e.g. 6 vertices for a square, etc...
+                vkCmdDraw(*commandBuffer, static_cast<uint32_t>(vertices.size()), drawInstanceCount, 0, 0);
+            }
         }
     }
 
+    // Split the draws evenly across the secondary command buffers, each recorded by its own thread of recordingThreads (the first on the calling thread),
+    // and execute them from the primary command buffer. The scene subpass must have been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    // Every secondary command buffer comes from a separate command pool, as a pool must not be used by several threads at once.
+    void recordSecondaryCommandBuffers(VkCommandBuffer* commandBuffer, std::vector<VkCommandBuffer>* secondaryCommandBuffers, RecordingThreadPool* recordingThreads, uint32_t secondaryCount, uint32_t drawCount, uint32_t instanceCount, const std::vector<uint32_t>* visibleObjects, VkDescriptorSet descriptorSet, const std::vector<ObjectUniformData>* objectData, VkDeviceSize objectUniformStride, VkBuffer* indexBuffer, VkBuffer* vertexBuffer, VkBuffer instanceBuffer, VkBuffer indirectBuffer, VkBuffer drawCountBuffer, std::vector<VkPipeline>* graphicsPipelines, std::vector<uint32_t>* graphicsPipelineIndices, DeviceCapabilities* deviceCapabilities, VkRenderPass* renderPass, VkFramebuffer framebuffer, VkPipelineLayout* pipelineLayout, VkExtent2D* swapChainExtent) {
+        // the secondary command buffers continue the scene subpass of the render pass begun in the primary command buffer
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = *renderPass;
+        inheritanceInfo.subpass = sceneSubpass;
+        inheritanceInfo.framebuffer = framebuffer; // optional, but lets the driver optimize for the actual attachments
+
+        std::function<void(uint32_t)> recordSecondary = [&](uint32_t index) {
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+            VkCommandBuffer* secondaryCommandBuffer = &secondaryCommandBuffers->at(index);
+            if (vkBeginCommandBuffer(*secondaryCommandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("failed to begin recording secondary command buffer!");
+            }
+
+            uint32_t firstDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * index / secondaryCount);
+            uint32_t lastDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (index + 1) / secondaryCount);
+            recordSceneDraws(secondaryCommandBuffer, firstDraw, lastDraw - firstDraw, instanceCount, visibleObjects, false, descriptorSet, objectData, objectUniformStride, indexBuffer, vertexBuffer, instanceBuffer, indirectBuffer, drawCountBuffer, graphicsPipelines, graphicsPipelineIndices, deviceCapabilities, pipelineLayout, swapChainExtent);
+
+            if (vkEndCommandBuffer(*secondaryCommandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record secondary command buffer!");
+            }
+        };
+
+        recordingThreads->run(secondaryCount, recordSecondary); // rethrows errors of the worker threads
+
+        vkCmdExecuteCommands(*commandBuffer, secondaryCount, secondaryCommandBuffers->data());
+    }
+
     // contains actual draw command containing info from renderpass, and buffers
-    void recordCommandBuffer(uint32_t currentFrame, uint32_t imageIndex, std::vector<VkDescriptorSet>* descriptorSets, VkBuffer* indexBuffer, VkBuffer* vertexBuffer, VkCommandBuffer* commandBuffer, VkCommandPool* commandPool, std::vector<VkPipeline>* graphicsPipelines, VkRenderPass* renderPass, VkPipelineLayout* pipelineLayout, std::vector<VkFramebuffer>* swapchainFramebuffers, VkExtent2D* swapChainExtent, VkDevice* device) {
+    void recordCommandBuffer(uint32_t currentFrame, uint32_t imageIndex, uint32_t instanceCount, const std::vector<uint32_t>* visibleObjects, std::vector<VkDescriptorSet>* descriptorSets, const std::vector<ObjectUniformData>* objectData, VkDeviceSize objectUniformStride, VkBuffer* indexBuffer, VkBuffer* vertexBuffer, VkBuffer* positionBuffer, std::vector<VkBuffer>* instanceBuffers, FrustumCulling* frustumCulling, VkCommandBuffer* commandBuffer, std::vector<VkCommandBuffer>* secondaryCommandBuffers, RecordingThreadPool* recordingThreads, VkQueryPool timestampQueryPool, VkQueryPool pipelineStatisticsQueryPool, std::vector<VkPipeline>* graphicsPipelines, std::vector<VkPipeline>* depthPrePassPipelines, std::vector<uint32_t>* graphicsPipelineIndices, DeviceCapabilities* deviceCapabilities, VkRenderPass* renderPass, VkPipelineLayout* pipelineLayout, std::vector<VkFramebuffer>* swapchainFramebuffers, VkExtent2D* swapChainExtent, VkDevice* device) {
         // The flags parameter specifies how the command buffer is used:
         // VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
         // VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : This is a secondary command buffer that will be entirely within a single render pass.
@@ -897,6 +3347,17 @@ private:
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        // GPU time of the frame, two queries per frame in flight, see readFrameGpuMilliseconds
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(*commandBuffer, timestampQueryPool, currentFrame * 2, 2);
+            vkCmdWriteTimestamp(*commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2);
+        }
+
+        // the culled draws are written outside of the render pass, before they are read by it
+        if (useGpuCulling && deviceCapabilities->drawIndirectCount) {
+            recordCullingDispatch(commandBuffer, currentFrame, frustumCulling);
+        }
+
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = *renderPass;
@@ -911,85 +3372,245 @@ private:
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
+        uint32_t objectDrawCount = objectDataInInstanceBuffer ? 1 : (useCpuCulling ? static_cast<uint32_t>(visibleObjects->size()) : sceneObjectCount);
+        uint32_t drawCount = static_cast<uint32_t>(graphicsPipelineIndices->size()) * objectDrawCount;
+        VkBuffer indirectBuffer = frustumCulling->getIndirectBuffer(currentFrame);
+        VkBuffer drawCountBuffer = frustumCulling->getDrawCountBuffer(currentFrame);
+
+        // triangles submitted by the frame, see readFrameSubmittedTriangles
+        if (pipelineStatisticsQueryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(*commandBuffer, pipelineStatisticsQueryPool, currentFrame, 1);
+            vkCmdBeginQuery(*commandBuffer, pipelineStatisticsQueryPool, currentFrame, 0);
+        }
+
+        // the depth pre-pass is recorded inline, only its vertex work is repeated and it is cheap compared to the shading it saves
+        if (useDepthPrePass) {
+            vkCmdBeginRenderPass(*commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            recordSceneDraws(commandBuffer, 0, drawCount, instanceCount, visibleObjects, true, descriptorSets->at(currentFrame), objectData, objectUniformStride, indexBuffer, positionBuffer, instanceBuffers->at(currentFrame), indirectBuffer, drawCountBuffer, depthPrePassPipelines, graphicsPipelineIndices, deviceCapabilities, pipelineLayout, swapChainExtent);
+        }
+
         // Subpass contents parameter controls how the drawing commands within the render pass will be provided.
         // VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
         // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : The render pass commands will be executed from secondary command buffers.
-        vkCmdBeginRenderPass(*commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        VkSubpassContents subpassContents = secondaryCommandBuffers != nullptr ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+        if (useDepthPrePass) {
+            vkCmdNextSubpass(*commandBuffer, subpassContents);
+        }
+        else {
+            vkCmdBeginRenderPass(*commandBuffer, &renderPassInfo, subpassContents);
+        }
+
+        if (secondaryCommandBuffers != nullptr) {
+            recordSecondaryCommandBuffers(commandBuffer, secondaryCommandBuffers, recordingThreads, static_cast<uint32_t>(secondaryCommandBuffers->size()), drawCount, instanceCount, visibleObjects, descriptorSets->at(currentFrame), objectData, objectUniformStride, indexBuffer, vertexBuffer, instanceBuffers->at(currentFrame), indirectBuffer, drawCountBuffer, graphicsPipelines, graphicsPipelineIndices, deviceCapabilities, renderPass, renderPassInfo.framebuffer, pipelineLayout, swapChainExtent);
+        }
+        else {
+            recordSceneDraws(commandBuffer, 0, drawCount, instanceCount, visibleObjects, false, descriptorSets->at(currentFrame), objectData, objectUniformStride, indexBuffer, vertexBuffer, instanceBuffers->at(currentFrame), indirectBuffer, drawCountBuffer, graphicsPipelines, graphicsPipelineIndices, deviceCapabilities, pipelineLayout, swapChainExtent);
+        }
+
+        vkCmdEndRenderPass(*commandBuffer);
+
+        if (pipelineStatisticsQueryPool != VK_NULL_HANDLE) {
+            vkCmdEndQuery(*commandBuffer, pipelineStatisticsQueryPool, currentFrame);
+        }
+
+        // the depth of this frame is tested by the occlusion culling of the next one
+        if (frustumCulling->depthPyramid.pipeline != VK_NULL_HANDLE) {
+            recordDepthPyramidReduction(commandBuffer, &frustumCulling->depthPyramid);
+        }
+
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(*commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2 + 1);
+        }
+
+        if (vkEndCommandBuffer(*commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    // Reset the draw count and cull every object in the culling shader, which appends an indirect draw per visible object.
+    // The frame waited for the previous submission of this frame in flight, so only the writes of this command buffer need barriers.
+    void recordCullingDispatch(VkCommandBuffer* commandBuffer, uint32_t currentFrame, FrustumCulling* frustumCulling) {
+        vkCmdFillBuffer(*commandBuffer, frustumCulling->drawCountBuffers[currentFrame], 0, sizeof(uint32_t), 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(*commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, frustumCulling->pipeline);
+        vkCmdBindDescriptorSets(*commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, frustumCulling->pipelineLayout, 0, 1, &frustumCulling->descriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(*commandBuffer, frustumCulling->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FrustumCulling::Parameters), &frustumCulling->parameters);
+        vkCmdDispatch(*commandBuffer, (sceneObjectCount + FrustumCulling::WORKGROUP_SIZE - 1) / FrustumCulling::WORKGROUP_SIZE, 1, 1);
+
+        // the draws and their count are read as indirect parameters
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Reduce the depth attachment into the depth pyramid level by level. The depth attachment is read only in between, the next render pass
+    // clears it again. The barrier after each level also makes the pyramid visible to the culling dispatch of the next frame.
+    void recordDepthPyramidReduction(VkCommandBuffer* commandBuffer, DepthPyramid* depthPyramid) {
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for (VkImageMemoryBarrier& barrier : barriers) {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        }
+        barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        barriers[0].image = depthPyramid->depthImage;
+        barriers[0].subresourceRange = { depthPyramid->depthAspectMask, 0, 1, 0, 1 };
+
+        // the culling dispatch of this frame read all levels before they are overwritten
+        barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].image = depthPyramid->image;
+        barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid->levelCount, 0, 1 };
+        vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        vkCmdBindPipeline(*commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramid->pipeline);
+        for (uint32_t level = 0; level < depthPyramid->levelCount; level++) {
+            uint32_t levelWidth = std::max(depthPyramid->extent.width >> level, 1u);
+            uint32_t levelHeight = std::max(depthPyramid->extent.height >> level, 1u);
+            vkCmdBindDescriptorSets(*commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramid->pipelineLayout, 0, 1, &depthPyramid->descriptorSets[level], 0, nullptr);
+            vkCmdDispatch(*commandBuffer, (levelWidth + DepthPyramid::WORKGROUP_SIZE - 1) / DepthPyramid::WORKGROUP_SIZE, (levelHeight + DepthPyramid::WORKGROUP_SIZE - 1) / DepthPyramid::WORKGROUP_SIZE, 1);
+
+            barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+            vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+        }
+
+        // the next render pass waits for the reduction before it writes the depth attachment again
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        vkCmdPipelineBarrier(*commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[0]);
+    }
+
+    void createTimestampQueryPool(VkQueryPool* timestampQueryPool, VkDevice* device) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = GVEProject::MAX_FRAMES_IN_FLIGHT * 2; // start and end of each frame in flight
+
+        if (vkCreateQueryPool(*device, &queryPoolInfo, hostAllocator, timestampQueryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+
+    // GPU time of the last submission of a frame in flight, false if it is not available (yet)
+    bool readFrameGpuMilliseconds(uint32_t currentFrame, VkQueryPool timestampQueryPool, double* gpuMilliseconds, DeviceCapabilities* deviceCapabilities, VkDevice* device) {
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(*device, timestampQueryPool, currentFrame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return false;
+        }
+        *gpuMilliseconds = static_cast<double>(timestamps[1] - timestamps[0]) * deviceCapabilities->timestampPeriod / 1000000.0;
+        return true;
+    }
 
-        VkBuffer vertexBuffers[] = { *vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(*commandBuffer, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(*commandBuffer, *indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    void createPipelineStatisticsQueryPool(VkQueryPool* pipelineStatisticsQueryPool, VkDevice* device) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        queryPoolInfo.queryCount = GVEProject::MAX_FRAMES_IN_FLIGHT;
+        queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT;
 
-        // define dynamic states
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(swapChainExtent->width);
-        viewport.height = static_cast<float>(swapChainExtent->height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(*commandBuffer, 0, 1, &viewport);
+        if (vkCreateQueryPool(*device, &queryPoolInfo, hostAllocator, pipelineStatisticsQueryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline statistics query pool!");
+        }
+    }
 
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = *swapChainExtent;
-        vkCmdSetScissor(*commandBuffer, 0, 1, &scissor);
+    // triangles assembled by the last submission of a frame in flight, false if they are not available (yet)
+    bool readFrameSubmittedTriangles(uint32_t currentFrame, VkQueryPool pipelineStatisticsQueryPool, uint64_t* triangles, VkDevice* device) {
+        return vkGetQueryPoolResults(*device, pipelineStatisticsQueryPool, currentFrame, 1, sizeof(uint64_t), triangles, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    }
 
-        vkCmdBindDescriptorSets(*commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipelineLayout, 0, 1, &descriptorSets->at(currentFrame), 0, nullptr);
+    // Measure recording a growing number of draws inline and split across 2, 4, ... up to recordingThreadCount secondary command buffers of
+    // the first frame in flight, including the reset of its command pools. Only CPU time is measured, the command buffers are never submitted.
+    void benchmarkParallelRecordingPaths(std::vector<VkCommandPool>* framePools, std::vector<VkCommandBuffer>* secondaryCommandBuffers, RecordingThreadPool* recordingThreads, std::vector<VkDescriptorSet>* descriptorSets, VkDeviceSize objectUniformStride, VkBuffer* indexBuffer, VkBuffer* vertexBuffer, VkBuffer instanceBuffer, FrustumCulling* frustumCulling, std::vector<VkPipeline>* graphicsPipelines, std::vector<uint32_t>* graphicsPipelineIndices, DeviceCapabilities* deviceCapabilities, VkRenderPass* renderPass, VkFramebuffer framebuffer, VkExtent2D* swapChainExtent, VkPipelineLayout* pipelineLayout, VkCommandPool* commandPool, VkDevice* device) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = *commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
 
-        //actual draw command
-        // vertexCount
-        // instanceCount : Used for instanced rendering, use 1 if you're not doing that.
-        // firstVertex : Used as an offset into the vertex buffer, defines the lowest value of gl_VertexIndex.
-        // firstInstance : Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
-        // 
-       
-        if (GVEProject::USE_INDEXED_VERTICES) {
-            // reuse vertices by using their indices and place them in order specified by "indices" array
-            // saves about 50% of memory for vertices
-            // std::cout << "Using indexed vertices in draw command. Please make sure to specify the order of vertices." << std::endl;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(*device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate benchmark command buffer!");
+        }
 
-            // bind each pipeline to graphic
-            
-            for (auto pipeline : *graphicsPipelines) {
-                vkCmdBindPipeline(*commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-                vkCmdDrawIndexed(*commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+        // the object data of the frame is only filled in drawFrame
+        ObjectUniformData object{};
+        object.model = glm::mat4(1.0f);
+        object.materialColor = glm::vec4(1.0f);
+        std::vector<ObjectUniformData> objectData(sceneObjectCount, object);
+        std::vector<uint32_t> visibleObjects(sceneObjectCount);
+        for (uint32_t i = 0; i < sceneObjectCount; i++) {
+            visibleObjects[i] = i;
+        }
+
+        auto measureMilliseconds = [&](uint32_t drawCount, uint32_t threadCount) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            auto startTime = std::chrono::high_resolution_clock::now();
+            resetFrameCommandPools(framePools, device);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = *renderPass;
+            renderPassInfo.framebuffer = framebuffer;
+            renderPassInfo.renderArea.extent = *swapChainExtent;
+            if (threadCount > 1) {
+                beginSceneSubpass(&commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                recordSecondaryCommandBuffers(&commandBuffer, secondaryCommandBuffers, recordingThreads, threadCount, drawCount, sceneObjectCount, &visibleObjects, descriptorSets->at(0), &objectData, objectUniformStride, indexBuffer, vertexBuffer, instanceBuffer, frustumCulling->getIndirectBuffer(0), frustumCulling->getDrawCountBuffer(0), graphicsPipelines, graphicsPipelineIndices, deviceCapabilities, renderPass, framebuffer, pipelineLayout, swapChainExtent);
+            }
+            else {
+                beginSceneSubpass(&commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                recordSceneDraws(&commandBuffer, 0, drawCount, sceneObjectCount, &visibleObjects, false, descriptorSets->at(0), &objectData, objectUniformStride, indexBuffer, vertexBuffer, instanceBuffer, frustumCulling->getIndirectBuffer(0), frustumCulling->getDrawCountBuffer(0), graphicsPipelines, graphicsPipelineIndices, deviceCapabilities, pipelineLayout, swapChainExtent);
             }
 
-            //vkCmdBindPipeline(*commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines->at(0));
-            //vkCmdDrawIndexed(*commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-            
+            vkCmdEndRenderPass(commandBuffer);
+            vkEndCommandBuffer(commandBuffer);
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        };
 
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threadCount = 1; threadCount < recordingThreadCount; threadCount *= 2) {
+            threadCounts.push_back(threadCount);
         }
-        else {
-            // use non-indexed vertices
-            // make sure to add the correct amount of vertices for each primitive/triangle.
-            // --> three vertices for each triangle, e.g. 6 vertices for a square, etc...
-            // std::cout << "Using non-indexed vertices in draw command. Please make sure to specify the amount and layout of vertices correctly when using this option." << std::endl;
-            
-            // bind each pipeline to graphics
-            for (auto &pipeline : *graphicsPipelines) {
-                vkCmdBindPipeline(*commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-                vkCmdDraw(*commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+        threadCounts.push_back(recordingThreadCount);
+
+        std::cout << "Parallel recording benchmark (recording only, " << std::thread::hardware_concurrency() << " hardware threads):" << std::endl;
+        for (uint32_t drawCount : { 1000u, 10000u, 100000u }) {
+            std::cout << "\t" << drawCount << " draws:";
+            for (uint32_t threadCount : threadCounts) {
+                std::cout << " " << threadCount << (threadCount == 1 ? " thread " : " threads ") << measureMilliseconds(drawCount, threadCount) << " ms,";
             }
+            std::cout << std::endl;
         }
 
-        vkCmdEndRenderPass(*commandBuffer);
-
-        if (vkEndCommandBuffer(*commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
-        }
+        vkFreeCommandBuffers(*device, *commandPool, 1, &commandBuffer);
     }
 
-
-    void createFramebuffers(VkImageView* depthImageView, std::vector<VkFramebuffer>* swapchainFramebuffers, VkExtent2D* swapChainExtent, std::vector<VkImageView>* swapChainImageViews, VkRenderPass* renderPass, VkDevice* device) {
+    // colorImageView is the multisampled color attachment or VK_NULL_HANDLE without multisampling, see createRenderPass for the attachment order
+    void createFramebuffers(VkImageView* colorImageView, VkImageView* depthImageView, std::vector<VkFramebuffer>* swapchainFramebuffers, VkExtent2D* swapChainExtent, std::vector<VkImageView>* swapChainImageViews, VkRenderPass* renderPass, VkDevice* device) {
         swapchainFramebuffers->resize(swapChainImageViews->size());
         for (size_t i = 0; i < swapChainImageViews->size(); i++) {//create framebuffer for each image view
-            std::array<VkImageView, 2> attachments = {
-                swapChainImageViews->at(i),
-                *depthImageView
-            };
+            std::vector<VkImageView> attachments = { swapChainImageViews->at(i), *depthImageView };
+            if (*colorImageView != VK_NULL_HANDLE) {
+                attachments = { *colorImageView, *depthImageView, swapChainImageViews->at(i) }; // the swapchain image is the resolve attachment
+            }
 
             VkFramebufferCreateInfo framebufferInfo{};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -1000,7 +3621,7 @@ private:
             framebufferInfo.height = swapChainExtent->height;
             framebufferInfo.layers = 1;
 
-            if (vkCreateFramebuffer(*device, &framebufferInfo, nullptr, &swapchainFramebuffers->at(i)) != VK_SUCCESS) {
+            if (vkCreateFramebuffer(*device, &framebufferInfo, hostAllocator, &swapchainFramebuffers->at(i)) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create framebuffer!");
             }
         }
@@ -1019,7 +3640,11 @@ private:
     ///////////////////////////////////////////////////////////
 
     // Render pass: the attachments referenced by the pipeline stages and their usage
-    void createRenderPass(VkRenderPass* renderPass, VkFormat* swapChainImageFormat, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    // Without multisampling the attachments are the swapchain image and the depth image. With msaaSamples above 1 they are the multisampled
+    // color and depth images, which are resolved into the swapchain image as third attachment at the end of the scene subpass.
+    void createRenderPass(VkRenderPass* renderPass, VkFormat* swapChainImageFormat, DeviceCapabilities* deviceCapabilities, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+        bool multisampled = deviceCapabilities->msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
         // single color buffer attachment by one image from swapchain
         VkAttachmentDescription colorAttachment{};
         VkAttachmentDescription depthAttachment{};
@@ -1027,8 +3652,8 @@ private:
         colorAttachment.format = *swapChainImageFormat; //format should match swap chain image format
         depthAttachment.format = VulkanDrawingInitializer::findDepthFormat(physicalDevice); // The format should be the same as the depth image itself
 
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; //no multisampling for now
-        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.samples = deviceCapabilities->msaaSamples; // all pipelines rasterize with the sample count of the attachments
+        depthAttachment.samples = deviceCapabilities->msaaSamples;
 
         // loading operation before rendering
         // VK_ATTACHMENT_LOAD_OP_LOAD: Preserve the existing contents of the attachment
@@ -1040,8 +3665,8 @@ private:
         // storing operation after rendering
         // VK_ATTACHMENT_STORE_OP_STORE: Rendered contents will be stored in memory and can be read later
         // VK_ATTACHMENT_STORE_OP_DONT_CARE : Contents of the framebuffer will be undefined after the rendering operation
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; //store to show on screen 
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // don't care about storing the depth data (storeOp), because it will not be used after drawing has finished
+        colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE; //store to show on screen, the multisampled color is only needed for the resolve
+        depthAttachment.storeOp = useOcclusionCulling ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE; // don't care about storing the depth data (storeOp) unless it is reduced into the depth pyramid after drawing has finished
 
 
         // stencil buffer is not in use at the moment
@@ -1059,7 +3684,7 @@ private:
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // specify format before render pass begins, undefined if load op is clear
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // layout transition to when renderpass finishes
+        colorAttachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // layout transition to when renderpass finishes
         depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
         // Render subpasses
@@ -1084,6 +3709,31 @@ private:
         subpass.pColorAttachments = &colorAttachmentReference;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+        // the multisampled color is resolved into the swapchain image within the render pass, so it never leaves tile memory on tile-based GPUs
+        VkAttachmentDescription resolveAttachment{};
+        resolveAttachment.format = *swapChainImageFormat;
+        resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // every pixel is overwritten by the resolve
+        resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkAttachmentReference resolveAttachmentReference{};
+        resolveAttachmentReference.attachment = 2;
+        resolveAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        if (multisampled) {
+            subpass.pResolveAttachments = &resolveAttachmentReference;
+        }
+
+        // the depth pre-pass of useDepthPrePass only writes the depth attachment, the scene subpass follows it
+        VkSubpassDescription depthPrePassSubpass{};
+        depthPrePassSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        depthPrePassSubpass.colorAttachmentCount = 0;
+        depthPrePassSubpass.pDepthStencilAttachment = &depthAttachmentRef;
+        std::vector<VkSubpassDescription> subpasses = useDepthPrePass ? std::vector<VkSubpassDescription>{ depthPrePassSubpass, subpass } : std::vector<VkSubpassDescription>{ subpass };
+
 
         // Steer transition of renderpass using a dependency to wait for a specific stage
         // The dstSubpass must always be higher than srcSubpass to prevent cycles in the dependency graph (unless one of the subpasses is VK_SUBPASS_EXTERNAL)
@@ -1095,24 +3745,49 @@ private:
         // These settings will prevent the transition from happening until it's actually necessary (and allowed): when we want to start writing colors to it.
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
         dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        std::vector<VkSubpassDependency> dependencies = { dependency };
+
+        if (useDepthPrePass) {
+            // the color attachment is first used by the scene subpass
+            VkSubpassDependency colorDependency = dependency;
+            colorDependency.dstSubpass = sceneSubpass;
+            colorDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            colorDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            colorDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependencies.push_back(colorDependency);
+
+            // the scene subpass tests against the depth written by the pre-pass
+            VkSubpassDependency depthDependency{};
+            depthDependency.srcSubpass = 0;
+            depthDependency.dstSubpass = sceneSubpass;
+            depthDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            depthDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT; // each pixel only depends on its own depth
+            dependencies.push_back(depthDependency);
+        }
 
         // use color and depth attachment for renderpass
-        std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+        std::vector<VkAttachmentDescription> attachments = { colorAttachment, depthAttachment };
+        if (multisampled) {
+            attachments.push_back(resolveAttachment);
+        }
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
         renderPassInfo.pAttachments = attachments.data();
-        renderPassInfo.subpassCount = 1;
-        renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+        renderPassInfo.pSubpasses = subpasses.data();
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
-        if (vkCreateRenderPass(*device, &renderPassInfo, nullptr, renderPass) != VK_SUCCESS) {
+        if (vkCreateRenderPass(*device, &renderPassInfo, hostAllocator, renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
     }
     // Fixed-function stage : all of the structures that define the fixed - function stages of the pipeline, like input assembly, rasterizer, viewport and color blending
-    void setupFixedFunctionStage(GVEProject::FixedFunctionStageParameters pipelineParameters,
+    void setupFixedFunctionStage(const GVEProject::FixedFunctionStageParameters& pipelineParameters,
         std::vector<VkDynamicState>& dynamicStates,
         VkPipelineInputAssemblyStateCreateInfo& inputAssemblyInfo,
         VkPipelineDynamicStateCreateInfo& dynamicStateInfo,
@@ -1121,7 +3796,7 @@ private:
         VkPipelineMultisampleStateCreateInfo& multisamplingInfo,
         VkPipelineDepthStencilStateCreateInfo& depthStencilInfo,
         VkPipelineColorBlendAttachmentState& colorBlendAttachment,
-        VkPipelineColorBlendStateCreateInfo& colorBlendingInfo, VkExtent2D* swapChainExtent) {
+        VkPipelineColorBlendStateCreateInfo& colorBlendingInfo, DeviceCapabilities* deviceCapabilities, VkExtent2D* swapChainExtent) {
 
         //////////////////////// INPUT ASSEMBLY
         //
@@ -1139,10 +3814,44 @@ private:
         //////////////////////// DYNAMIC STATES
         //
         // create dynamic state to dynamically change viewport and scissor without recreating the whole pipeline at drawing time
+        // further fixed function state is set in recordCommandBuffer if supported, so pipelines only differing in this state can share one VkPipeline
         dynamicStates = {
             VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR
+            VK_DYNAMIC_STATE_SCISSOR,
+            VK_DYNAMIC_STATE_LINE_WIDTH,
+            VK_DYNAMIC_STATE_DEPTH_BIAS,
+            VK_DYNAMIC_STATE_BLEND_CONSTANTS,
+            VK_DYNAMIC_STATE_DEPTH_BOUNDS
         };
+        if (deviceCapabilities->extendedDynamicState) {
+            dynamicStates.insert(dynamicStates.end(), {
+                VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+                VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, // only within the topology class (points, lines, triangles) of the pipeline
+                VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+                VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+                VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT,
+                VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE_EXT,
+                VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT
+            });
+        }
+        if (deviceCapabilities->extendedDynamicState2) {
+            dynamicStates.insert(dynamicStates.end(), {
+                VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT,
+                VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT,
+                VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT
+            });
+        }
+        if (deviceCapabilities->extendedDynamicState3PolygonMode) {
+            dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+        }
+        if (deviceCapabilities->extendedDynamicState3ColorBlend) {
+            dynamicStates.insert(dynamicStates.end(), {
+                VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT,
+                VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT,
+                VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT
+            });
+        }
 
         dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
         dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
@@ -1211,13 +3920,18 @@ private:
         depthStencilInfo.stencilTestEnable = pipelineParameters.depthStencilInfo_stencilTestEnable;
         depthStencilInfo.front = {}; // Optional
         depthStencilInfo.back = {}; // Optional
+        if (hasDepthPrePass(pipelineParameters)) {
+            // the depth pre-pass already wrote the closest depth, only fragments with exactly that depth are shaded
+            depthStencilInfo.depthWriteEnable = VK_FALSE;
+            depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        }
 
         //////////////////////// MULTISAMPLING
         //
         // One Way to perform anti-aliasing, combine fragment shader results of multiple polygons to the same pixel
         multisamplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisamplingInfo.sampleShadingEnable = pipelineParameters.multisamplingInfo_sampleShadingEnable;
-        multisamplingInfo.rasterizationSamples = pipelineParameters.multisamplingInfo_rasterizationSamples;
+        multisamplingInfo.rasterizationSamples = deviceCapabilities->msaaSamples; // must match the attachments, see msaaSamples
         multisamplingInfo.minSampleShading = pipelineParameters.multisamplingInfo_minSampleShading; // Optional
         multisamplingInfo.pSampleMask = nullptr; // Optional
         multisamplingInfo.alphaToCoverageEnable = pipelineParameters.multisamplingInfo_alphaToCoverageEnable; // Optional
@@ -1258,53 +3972,137 @@ private:
         colorBlendingInfo.blendConstants[3] = pipelineParameters.colorBlendingInfo_blendConstants_3; // Optional
     }
 
-    // Shader stages : the shader modules that define the functionality of the programmable stages of the graphics pipeline
-    std::vector<VkShaderModule> setupShaderStageAndReturnModules(GVEProject::ShaderStageParameters shaderParameters, std::array<VkVertexInputAttributeDescription, Vertex::attributeCount> attributeDescriptions, VkVertexInputBindingDescription bindingDescription, VkPipelineVertexInputStateCreateInfo& vertexInputInfo, VkPipelineShaderStageCreateInfo& fragmentShaderStageInfo, VkPipelineShaderStageCreateInfo& vertexShaderStageInfo, VkDevice* device) {
-        std::string vertexShaderText = readShaderFile(shaderParameters.vertexShaderText);
-        std::string fragmentShaderText = readShaderFile(shaderParameters.fragmentShaderText);
+    // Shader module together with the hash of its SPIR-V code, used to identify identical pipelines
+    struct CompiledShaderModule {
+        VkShaderModule module;
+        size_t codeHash;
+    };
+
+#ifdef GVE_EMBEDDED_SHADERS
+    // Look up the SPIR-V of a shader permutation embedded at build time
+    const GVEEmbeddedShaders::EmbeddedShader& findEmbeddedShader(const std::string& shaderFile, const char* shaderType, const std::string& shaderDefines) {
+        for (const GVEEmbeddedShaders::EmbeddedShader& embeddedShader : GVEEmbeddedShaders::SHADERS) {
+            if (shaderFile == embeddedShader.shaderFile && strcmp(shaderType, embeddedShader.shaderType) == 0 && shaderDefines == embeddedShader.shaderDefines) {
+                return embeddedShader;
+            }
+        }
+        throw std::runtime_error("shader is not embedded, rebuild to run embed_shaders.py: " + shaderFile + " [" + shaderDefines + "]");
+    }
+#endif
+
+    // A shader permutation is a shader file compiled with one set of preprocessor defines
+    struct ShaderPermutation {
+        std::string shaderFile;
+        const char* shaderType;
+        std::string shaderDefines;
+    };
+
+    static std::string makeShaderPermutationKey(const char* shaderType, const std::string& shaderFile, const std::string& shaderDefines) {
+        return std::string(shaderType) + ":" + shaderFile + ":" + shaderDefines;
+    }
+
+    // Wrap SPIR-V code into a shader module of shaderModuleCache
+    void addShaderModule(std::map<std::string, CompiledShaderModule>* shaderModuleCache, const std::string& cacheKey, const uint32_t* code, size_t codeWordCount, VkDevice* device) {
+        CompiledShaderModule compiledModule{};
+        compiledModule.module = createShaderModule(code, codeWordCount, *device);
+        compiledModule.codeHash = std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(code), codeWordCount * sizeof(uint32_t)));
+        (*shaderModuleCache)[cacheKey] = compiledModule;
+    }
+
+    // Compile every shader permutation used by the pipelines once, compilations run in parallel and the modules are created afterwards
+    void compileShaderPermutations(std::map<std::string, CompiledShaderModule>* shaderModuleCache, const std::vector<GVEProject::ShaderStageParameters>* pipelineShaders, VkDevice* device) {
+        std::map<std::string, ShaderPermutation> permutations;
+        for (const GVEProject::ShaderStageParameters& shaders : *pipelineShaders) {
+            permutations.try_emplace(makeShaderPermutationKey("vertex", shaders.vertexShaderText, shaders.vertexShaderDefines), ShaderPermutation{ shaders.vertexShaderText, "vertex", shaders.vertexShaderDefines });
+            permutations.try_emplace(makeShaderPermutationKey("fragment", shaders.fragmentShaderText, shaders.fragmentShaderDefines), ShaderPermutation{ shaders.fragmentShaderText, "fragment", shaders.fragmentShaderDefines });
+        }
+        if (useDepthPrePass) {
+            permutations.try_emplace(makeShaderPermutationKey("vertex", GVEProject::DEPTH_PREPASS_VERTEX_SHADER, ""), ShaderPermutation{ GVEProject::DEPTH_PREPASS_VERTEX_SHADER, "vertex", "" });
+        }
+
+#ifdef GVE_EMBEDDED_SHADERS
+        for (const auto& [cacheKey, permutation] : permutations) {
+            const GVEEmbeddedShaders::EmbeddedShader& embeddedShader = findEmbeddedShader(permutation.shaderFile, permutation.shaderType, permutation.shaderDefines);
+            addShaderModule(shaderModuleCache, cacheKey, embeddedShader.code, embeddedShader.wordCount, device);
+        }
+#else
+        // workers only load or compile, all output is printed here so the lines of several permutations do not interleave
+        std::map<std::string, std::future<CachedShaderCode>> compilations;
+        for (const auto& [cacheKey, permutation] : permutations) {
+            std::cout << "Compiling Shader: " << permutation.shaderType << " [" << permutation.shaderDefines << "]" << std::endl;
+            compilations[cacheKey] = std::async(std::launch::async, [permutation]() {
+                return loadOrCompileShader(permutation.shaderFile, permutation.shaderType, permutation.shaderDefines);
+            });
+        }
+
+        for (auto& [cacheKey, compilation] : compilations) {
+            const ShaderPermutation& permutation = permutations.at(cacheKey);
+            CachedShaderCode shader = compilation.get(); // rethrows compile errors of the worker
+            std::cout << (shader.loadedFromCache ? "Shader loaded from cache: " : "Shader compiled: ") << permutation.shaderType << " [" << permutation.shaderDefines << "]" << std::endl;
+            addShaderModule(shaderModuleCache, cacheKey, shader.code.data(), shader.code.size(), device);
+        }
+#endif
+    }
+
+    // Return the module of a shader permutation compiled by compileShaderPermutations
+    CompiledShaderModule getShaderPermutationModule(std::map<std::string, CompiledShaderModule>* shaderModuleCache, const char* shaderType, const std::string& shaderFile, const std::string& shaderDefines) {
+        auto cachedModule = shaderModuleCache->find(makeShaderPermutationKey(shaderType, shaderFile, shaderDefines));
+        if (cachedModule == shaderModuleCache->end()) {
+            throw std::runtime_error("shader permutation was not compiled: " + shaderFile + " [" + shaderDefines + "]");
+        }
+
+        return cachedModule->second;
+    }
 
-        auto vertexShaderCode = compileShader(vertexShaderText, "vertex");
-        auto fragmentShaderCode = compileShader(fragmentShaderText, "fragment");
+    // constant_id 0 of the vertex shader: read the object data from push constants instead of the uniform buffer
+    // constant_id 1 of the vertex shader: read the object data from the instance buffer, takes precedence over constant_id 0
+    static constexpr VkBool32 objectDataSpecialization[] = { objectDataInPushConstants ? VK_TRUE : VK_FALSE, objectDataInInstanceBuffer ? VK_TRUE : VK_FALSE };
+    static constexpr VkSpecializationMapEntry objectDataSpecializationEntries[] = { { 0, 0, sizeof(VkBool32) }, { 1, sizeof(VkBool32), sizeof(VkBool32) } };
+    static inline const VkSpecializationInfo objectDataSpecializationInfo{ 2, objectDataSpecializationEntries, sizeof(objectDataSpecialization), objectDataSpecialization };
 
-        VkShaderModule vertexShaderModule = createShaderModule({ vertexShaderCode.cbegin(),vertexShaderCode.cend() }, *device);
-        VkShaderModule fragmentShaderModule = createShaderModule({ fragmentShaderCode.cbegin(),fragmentShaderCode.cend() }, *device);
+    // Shader stages : the shader modules that define the functionality of the programmable stages of the graphics pipeline
+    // Modules are owned by shaderModuleCache and destroyed by the caller once all pipelines are created
+    std::vector<CompiledShaderModule> setupShaderStageAndReturnModules(const GVEProject::ShaderStageParameters& shaderParameters, std::map<std::string, CompiledShaderModule>* shaderModuleCache, const std::array<VkVertexInputAttributeDescription, Vertex::attributeCount>& attributeDescriptions, const std::array<VkVertexInputBindingDescription, Vertex::bindingCount>& bindingDescriptions, VkPipelineVertexInputStateCreateInfo& vertexInputInfo, VkPipelineShaderStageCreateInfo& fragmentShaderStageInfo, VkPipelineShaderStageCreateInfo& vertexShaderStageInfo) {
+        CompiledShaderModule vertexShaderModule = getShaderPermutationModule(shaderModuleCache, "vertex", shaderParameters.vertexShaderText, shaderParameters.vertexShaderDefines);
+        CompiledShaderModule fragmentShaderModule = getShaderPermutationModule(shaderModuleCache, "fragment", shaderParameters.fragmentShaderText, shaderParameters.fragmentShaderDefines);
 
         vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertexShaderStageInfo.module = vertexShaderModule;
+        vertexShaderStageInfo.module = vertexShaderModule.module;
         vertexShaderStageInfo.pName = shaderParameters.vertexShaderEntryFunctionName; // choose entry point function within shader
-        vertexShaderStageInfo.pSpecializationInfo = nullptr; // add shader constants if used, to get optimization features by compiler
+        vertexShaderStageInfo.pSpecializationInfo = &objectDataSpecializationInfo; // shader constants let the compiler drop the unused source of the object data
 
         fragmentShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragmentShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragmentShaderStageInfo.module = fragmentShaderModule;
+        fragmentShaderStageInfo.module = fragmentShaderModule.module;
         fragmentShaderStageInfo.pName = shaderParameters.fragmentShaderEntryFunctionName;
-        vertexShaderStageInfo.pSpecializationInfo = nullptr; // add shader constants if used, to get optimization features by compiler
+        fragmentShaderStageInfo.pSpecializationInfo = nullptr; // add shader constants if used, to get optimization features by compiler
 
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; // Bindings: spacing between data and whether the data is per-vertex or per-instance
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data(); // Bindings: spacing between data and whether the data is per-vertex or per-instance
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); // Attribute descriptions: type of the attributes passed to the vertex shader, which binding to load them from and at which offset
     
-        return std::vector<VkShaderModule>{vertexShaderModule, fragmentShaderModule};
+        return std::vector<CompiledShaderModule>{vertexShaderModule, fragmentShaderModule};
     }
 
     // Thin wrapper for the actual SPIRV code of a shader
-    VkShaderModule createShaderModule(const std::vector<uint32_t>& code, VkDevice device) {
+    VkShaderModule createShaderModule(const uint32_t* code, size_t codeWordCount, VkDevice device) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size() * sizeof(uint32_t); // get correct codelength
-        createInfo.pCode = code.data();
+        createInfo.codeSize = codeWordCount * sizeof(uint32_t); // get correct codelength
+        createInfo.pCode = code;
 
         VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        if (vkCreateShaderModule(device, &createInfo, hostAllocator, &shaderModule) != VK_SUCCESS) {
             throw std::runtime_error("failed to create shader module!");
         }
         
         return shaderModule;
     }
 
+#ifndef GVE_EMBEDDED_SHADERS
     // Read shader file to compile within the program itself
     static std::string readShaderFile(const std::string& filename) {
         std::ifstream file(filename);
@@ -1313,45 +4111,645 @@ private:
             throw std::runtime_error("failed to open!" + filename);
         }
 
-        std::string shaderText((std::istreambuf_iterator<char>(file)),
-            std::istreambuf_iterator<char>());
+        std::string shaderText((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+
+        return shaderText;
+    }
+    // FIXME: remember to add information to use shaderc_combinedd.lib for debug and shaderc_combinedd.lib for release in the linker Input @properties of VS!!
+    // Split a define set such as "DEBUG_UV;SCALE=2" into macro names and values
+    static std::vector<std::pair<std::string, std::string>> parseShaderDefines(const std::string& shaderDefines) {
+        std::vector<std::pair<std::string, std::string>> defines;
+        std::stringstream defineStream(shaderDefines);
+        std::string define;
+        while (std::getline(defineStream, define, ';')) {
+            if (define.empty()) {
+                continue;
+            }
+            size_t separator = define.find('=');
+            if (separator == std::string::npos) {
+                defines.emplace_back(define, "");
+            } else {
+                defines.emplace_back(define.substr(0, separator), define.substr(separator + 1));
+            }
+        }
+
+        return defines;
+    }
+
+    // compile shader text into spirv code format, static as it is called from several threads at once
+    static shaderc::SpvCompilationResult compileShader(std::string source_text, const char* shader_type, const std::string& shader_defines){
+
+        shaderc_shader_kind shader_kind;
+        if (strcmp(shader_type, "vertex") == 0) {
+            shader_kind = shaderc_glsl_vertex_shader;
+        } else if (strcmp(shader_type, "fragment") == 0) {
+            shader_kind = shaderc_glsl_fragment_shader;
+        } else if (strcmp(shader_type, "compute") == 0) {
+            shader_kind = shaderc_glsl_compute_shader;
+        }
+        else {
+            throw std::runtime_error("provided shader type not usable:" + (std::string)shader_type);
+        }
+
+        shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+        if constexpr (GVEProject::REDUCE_SPIRV_CODE_SIZE) {
+            options.SetOptimizationLevel(shaderc_optimization_level_size);
+        }
+        for (const auto& [name, value] : parseShaderDefines(shader_defines)) {
+            options.AddMacroDefinition(name, value);
+        }
+
+        shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source_text, shader_kind, shader_type, options);
+
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+            throw std::runtime_error(result.GetErrorMessage());
+        }
+
+        return result ;
+    }
+
+    // SPIR-V of a shader permutation and whether it was read from shaderCacheDirectory instead of compiled
+    struct CachedShaderCode {
+        std::vector<uint32_t> code;
+        bool loadedFromCache;
+    };
+
+    // FNV-1a, unlike std::hash its value is the same for every build so cache files stay valid across compilers and standard libraries
+    static uint64_t hashShaderSource(const std::string& text) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    // Load the SPIR-V of a shader permutation from shaderCacheDirectory or compile it and store it there, static as it is called from
+    // several threads at once. The file name hashes everything the SPIR-V depends on, so edited shaders and changed defines miss the cache.
+    static CachedShaderCode loadOrCompileShader(const std::string& shaderFile, const char* shaderType, const std::string& shaderDefines) {
+        std::string sourceText = readShaderFile(shaderFile);
+        if (shaderCacheDirectory[0] == '\0') {
+            shaderc::SpvCompilationResult result = compileShader(sourceText, shaderType, shaderDefines);
+            return CachedShaderCode{ std::vector<uint32_t>(result.cbegin(), result.cend()), false };
+        }
+
+        std::ostringstream cacheName;
+        cacheName << std::hex << hashShaderSource(sourceText + '\0' + shaderType + '\0' + shaderDefines + '\0' + (GVEProject::REDUCE_SPIRV_CODE_SIZE ? "size" : "none")) << ".spv";
+        std::filesystem::path cachePath = std::filesystem::path(shaderCacheDirectory) / cacheName.str();
+
+        std::ifstream cacheFile(cachePath, std::ios::binary | std::ios::ate);
+        if (cacheFile.is_open()) {
+            size_t fileSize = static_cast<size_t>(cacheFile.tellg());
+            std::vector<uint32_t> code(fileSize / sizeof(uint32_t));
+            cacheFile.seekg(0);
+            // a truncated or foreign file is compiled again and overwritten
+            if (fileSize != 0 && fileSize % sizeof(uint32_t) == 0 && cacheFile.read(reinterpret_cast<char*>(code.data()), fileSize) && code[0] == 0x07230203) {
+                return CachedShaderCode{ code, true };
+            }
+        }
+
+        shaderc::SpvCompilationResult result = compileShader(sourceText, shaderType, shaderDefines);
+        std::vector<uint32_t> code(result.cbegin(), result.cend());
+
+        // written to a file of its own and renamed, so a concurrently started application never reads a partial file
+        std::error_code error;
+        std::filesystem::create_directories(shaderCacheDirectory, error);
+        std::filesystem::path temporaryPath = cachePath;
+        temporaryPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+        std::ofstream temporaryFile(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (temporaryFile.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t))) {
+            temporaryFile.close();
+            std::filesystem::rename(temporaryPath, cachePath, error);
+        }
+        if (error || !temporaryFile) {
+            std::filesystem::remove(temporaryPath, error); // the cache is an optimization, the compiled code is used either way
+        }
+
+        return CachedShaderCode{ code, false };
+    }
+#endif
+
+    // Compute pipeline of useGpuCulling, its shader is not part of a graphics pipeline and compiled on its own
+    void createCullingPipeline(FrustumCulling* frustumCulling, VkDevice* device) {
+        // binding 0: view and projection, 1: object data, 2: indirect draws, 3: draw count, 4: depth pyramid
+        std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+        for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+            bindings[binding].binding = binding;
+            bindings[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : (binding == 4 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            bindings[binding].descriptorCount = 1;
+            bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(*device, &layoutInfo, hostAllocator, &frustumCulling->descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor set layout!");
+        }
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(FrustumCulling::Parameters);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &frustumCulling->descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(*device, &pipelineLayoutInfo, hostAllocator, &frustumCulling->pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling pipeline layout!");
+        }
+
+        if (createComputePipeline(GVEProject::CULLING_COMPUTE_SHADER, frustumCulling->pipelineLayout, &frustumCulling->pipeline, device) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling pipeline!");
+        }
+    }
+
+    void createDepthPyramidPipeline(DepthPyramid* depthPyramid, VkDevice* device) {
+        // binding 0: depth attachment or level above, 1: level written
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+        for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+            bindings[binding].binding = binding;
+            bindings[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            bindings[binding].descriptorCount = 1;
+            bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(*device, &layoutInfo, hostAllocator, &depthPyramid->descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &depthPyramid->descriptorSetLayout;
+
+        if (vkCreatePipelineLayout(*device, &pipelineLayoutInfo, hostAllocator, &depthPyramid->pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+        }
+
+        if (createComputePipeline(GVEProject::DEPTH_PYRAMID_COMPUTE_SHADER, depthPyramid->pipelineLayout, &depthPyramid->pipeline, device) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid pipeline!");
+        }
+    }
+
+    // compute shaders are listed in the project header without defines
+    VkResult createComputePipeline(const char* shaderFile, VkPipelineLayout pipelineLayout, VkPipeline* pipeline, VkDevice* device) {
+#ifdef GVE_EMBEDDED_SHADERS
+        const GVEEmbeddedShaders::EmbeddedShader& embeddedShader = findEmbeddedShader(shaderFile, "compute", "");
+        VkShaderModule shaderModule = createShaderModule(embeddedShader.code, embeddedShader.wordCount, *device);
+#else
+        std::cout << "Compiling Shader: compute [" << shaderFile << "]" << std::endl;
+        CachedShaderCode shader = loadOrCompileShader(shaderFile, "compute", "");
+        std::cout << (shader.loadedFromCache ? "Shader loaded from cache: " : "Shader compiled: ") << "compute [" << shaderFile << "]" << std::endl;
+        VkShaderModule shaderModule = createShaderModule(shader.code.data(), shader.code.size(), *device);
+#endif
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+
+        VkResult result = vkCreateComputePipelines(*device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator, pipeline);
+        vkDestroyShaderModule(*device, shaderModule, hostAllocator);
+        return result;
+    }
+
+    // Create all pipelines at once, each pipeline compiles its complete shader and fixed function state
+    void createMonolithicGraphicsPipelines(std::vector<VkPipeline>* graphicsPipelines, std::vector<VkGraphicsPipelineCreateInfo>* pipelineInfos, VkDevice* device) {
+        graphicsPipelines->resize(pipelineInfos->size());
+
+        if (vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, static_cast<uint32_t>(pipelineInfos->size()), pipelineInfos->data(), hostAllocator, graphicsPipelines->data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+    }
+
+    // Depth-only variant of every pipeline drawing an entry with hasDepthPrePass, VK_NULL_HANDLE for the other pipelines. The variant reads the
+    // position buffer, has no fragment shader and no color attachment, and writes depth with the compare op of the entry in the pre-pass subpass.
+    void createDepthPrePassPipelines(std::vector<VkPipeline>* depthPrePassPipelines, std::vector<uint32_t>* pipelineIndices, std::vector<VkGraphicsPipelineCreateInfo>* pipelineInfos, std::map<std::string, CompiledShaderModule>* shaderModuleCache, VkDevice* device) {
+        std::vector<size_t> prePassEntries(pipelineInfos->size(), SIZE_MAX); // entry of PIPELINE_PARAMETERS drawn in the pre-pass with each pipeline
+        for (int i = 0; i < GVEProject::PIPELINE_COUNT; i++) {
+            if (hasDepthPrePass(GVEProject::PIPELINE_PARAMETERS[i])) {
+                prePassEntries[pipelineIndices->at(i)] = i;
+            }
+        }
+
+        VkPipelineShaderStageCreateInfo vertexShaderStageInfo{};
+        vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertexShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertexShaderStageInfo.module = getShaderPermutationModule(shaderModuleCache, "vertex", GVEProject::DEPTH_PREPASS_VERTEX_SHADER, "").module;
+        vertexShaderStageInfo.pName = "main";
+        vertexShaderStageInfo.pSpecializationInfo = &objectDataSpecializationInfo;
+
+        // binding 0 only holds the positions, binding 1 is the instance buffer as for the scene pipelines
+        auto bindingDescriptions = Vertex::getBindingDescriptions();
+        bindingDescriptions[0].stride = sizeof(glm::vec3);
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        for (VkVertexInputAttributeDescription attributeDescription : Vertex::getAttributeDescriptions()) {
+            if (attributeDescription.location == 0) {
+                attributeDescription.offset = 0;
+                attributeDescriptions.push_back(attributeDescription);
+            }
+            else if (attributeDescription.binding == 1) {
+                attributeDescriptions.push_back(attributeDescription);
+            }
+        }
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+        VkPipelineColorBlendStateCreateInfo colorBlendingInfo{};
+        colorBlendingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlendingInfo.attachmentCount = 0;
+
+        std::vector<VkPipelineDepthStencilStateCreateInfo> depthStencilInfos(pipelineInfos->size());
+        std::vector<VkGraphicsPipelineCreateInfo> prePassPipelineInfos;
+        std::vector<size_t> prePassPipelineIndices; // pipeline each pre-pass pipeline belongs to
+        for (size_t i = 0; i < pipelineInfos->size(); i++) {
+            if (prePassEntries[i] == SIZE_MAX) {
+                continue;
+            }
+            depthStencilInfos[i] = *pipelineInfos->at(i).pDepthStencilState;
+            depthStencilInfos[i].depthTestEnable = VK_TRUE;
+            depthStencilInfos[i].depthWriteEnable = VK_TRUE;
+            depthStencilInfos[i].depthCompareOp = GVEProject::PIPELINE_PARAMETERS[prePassEntries[i]].depthStencilInfo_depthCompareOp;
+
+            // everything else, e.g. rasterization and depth bias, stays as in the scene pipeline so both compute the same depth
+            VkGraphicsPipelineCreateInfo pipelineInfo = pipelineInfos->at(i);
+            pipelineInfo.stageCount = 1;
+            pipelineInfo.pStages = &vertexShaderStageInfo;
+            pipelineInfo.pVertexInputState = &vertexInputInfo;
+            pipelineInfo.pDepthStencilState = &depthStencilInfos[i];
+            pipelineInfo.pColorBlendState = &colorBlendingInfo;
+            pipelineInfo.subpass = 0;
+            prePassPipelineInfos.push_back(pipelineInfo);
+            prePassPipelineIndices.push_back(i);
+        }
+
+        depthPrePassPipelines->assign(pipelineInfos->size(), VK_NULL_HANDLE);
+        if (prePassPipelineInfos.empty()) {
+            return;
+        }
+        std::vector<VkPipeline> prePassPipelines;
+        createMonolithicGraphicsPipelines(&prePassPipelines, &prePassPipelineInfos, device);
+        for (size_t i = 0; i < prePassPipelines.size(); i++) {
+            depthPrePassPipelines->at(prePassPipelineIndices[i]) = prePassPipelines[i];
+        }
+    }
+
+    // Serialize pipeline state into a lookup key, e.g. the state a pipeline library part is built from
+    template<typename... Values>
+    static std::string makePipelineStateKey(const Values&... values) {
+        std::ostringstream key;
+        ((key << values << ';'), ...);
+        return key.str();
+    }
+
+    // Dynamic topology may only switch between topologies of the same class as the topology the pipeline was created with
+    static int getTopologyClass(VkPrimitiveTopology topology) {
+        switch (topology) {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+            return 0;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+            return 1;
+        case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+            return 3;
+        default:
+            return 2; // triangles
+        }
+    }
+
+    // Combine value into a running hash (boost::hash_combine)
+    template<typename T>
+    static void hashCombine(size_t& hash, const T& value) {
+        hash ^= std::hash<T>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+
+    // Visit every value of a fully resolved pipeline create info the pipeline is built from: SPIR-V of all stages, fixed function state that is not dynamic,
+    // layout and render pass. Expects shaderModules in the order of pipelineInfo.pStages
+    template<typename Visit>
+    static void visitGraphicsPipelineState(const VkGraphicsPipelineCreateInfo& pipelineInfo, const std::vector<CompiledShaderModule>& shaderModules, Visit visit) {
+        const VkPipelineDynamicStateCreateInfo* dynamicStateInfo = pipelineInfo.pDynamicState;
+        std::set<VkDynamicState> dynamicStates(dynamicStateInfo->pDynamicStates, dynamicStateInfo->pDynamicStates + dynamicStateInfo->dynamicStateCount);
+        auto isStatic = [&dynamicStates](VkDynamicState state) { return dynamicStates.count(state) == 0; };
+
+        for (VkDynamicState state : dynamicStates) {
+            visit(state);
+        }
+
+        for (uint32_t i = 0; i < pipelineInfo.stageCount; i++) {
+            visit(pipelineInfo.pStages[i].stage);
+            visit(shaderModules[i].codeHash);
+            visit(std::string(pipelineInfo.pStages[i].pName));
+        }
+
+        const VkPipelineVertexInputStateCreateInfo* vertexInput = pipelineInfo.pVertexInputState;
+        for (uint32_t i = 0; i < vertexInput->vertexBindingDescriptionCount; i++) {
+            visit(vertexInput->pVertexBindingDescriptions[i].binding);
+            visit(vertexInput->pVertexBindingDescriptions[i].stride);
+            visit(vertexInput->pVertexBindingDescriptions[i].inputRate);
+        }
+        for (uint32_t i = 0; i < vertexInput->vertexAttributeDescriptionCount; i++) {
+            visit(vertexInput->pVertexAttributeDescriptions[i].location);
+            visit(vertexInput->pVertexAttributeDescriptions[i].binding);
+            visit(vertexInput->pVertexAttributeDescriptions[i].format);
+            visit(vertexInput->pVertexAttributeDescriptions[i].offset);
+        }
+
+        const VkPipelineInputAssemblyStateCreateInfo* inputAssembly = pipelineInfo.pInputAssemblyState;
+        visit(isStatic(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT) ? static_cast<int>(inputAssembly->topology) : getTopologyClass(inputAssembly->topology));
+        if (isStatic(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT)) visit(inputAssembly->primitiveRestartEnable);
+
+        visit(pipelineInfo.pViewportState->viewportCount);
+        visit(pipelineInfo.pViewportState->scissorCount);
+
+        const VkPipelineRasterizationStateCreateInfo* rasterizer = pipelineInfo.pRasterizationState;
+        visit(rasterizer->depthClampEnable);
+        if (isStatic(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT)) visit(rasterizer->rasterizerDiscardEnable);
+        if (isStatic(VK_DYNAMIC_STATE_POLYGON_MODE_EXT)) visit(rasterizer->polygonMode);
+        if (isStatic(VK_DYNAMIC_STATE_CULL_MODE_EXT)) visit(rasterizer->cullMode);
+        if (isStatic(VK_DYNAMIC_STATE_FRONT_FACE_EXT)) visit(rasterizer->frontFace);
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT)) visit(rasterizer->depthBiasEnable);
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_BIAS)) {
+            visit(rasterizer->depthBiasConstantFactor);
+            visit(rasterizer->depthBiasClamp);
+            visit(rasterizer->depthBiasSlopeFactor);
+        }
+        if (isStatic(VK_DYNAMIC_STATE_LINE_WIDTH)) visit(rasterizer->lineWidth);
+
+        const VkPipelineMultisampleStateCreateInfo* multisampling = pipelineInfo.pMultisampleState;
+        visit(multisampling->rasterizationSamples);
+        visit(multisampling->sampleShadingEnable);
+        visit(multisampling->minSampleShading);
+        visit(multisampling->alphaToCoverageEnable);
+        visit(multisampling->alphaToOneEnable);
+
+        const VkPipelineDepthStencilStateCreateInfo* depthStencil = pipelineInfo.pDepthStencilState;
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT)) visit(depthStencil->depthTestEnable);
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT)) visit(depthStencil->depthWriteEnable);
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT)) visit(depthStencil->depthCompareOp);
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE_EXT)) visit(depthStencil->depthBoundsTestEnable);
+        if (isStatic(VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT)) visit(depthStencil->stencilTestEnable);
+        if (isStatic(VK_DYNAMIC_STATE_DEPTH_BOUNDS)) {
+            visit(depthStencil->minDepthBounds);
+            visit(depthStencil->maxDepthBounds);
+        }
+        for (const VkStencilOpState& stencilOp : { depthStencil->front, depthStencil->back }) {
+            visit(stencilOp.failOp);
+            visit(stencilOp.passOp);
+            visit(stencilOp.depthFailOp);
+            visit(stencilOp.compareOp);
+            visit(stencilOp.compareMask);
+            visit(stencilOp.writeMask);
+            visit(stencilOp.reference);
+        }
+
+        const VkPipelineColorBlendStateCreateInfo* colorBlending = pipelineInfo.pColorBlendState;
+        visit(colorBlending->logicOpEnable);
+        visit(colorBlending->logicOp);
+        for (uint32_t i = 0; i < colorBlending->attachmentCount; i++) {
+            const VkPipelineColorBlendAttachmentState& attachment = colorBlending->pAttachments[i];
+            if (isStatic(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT)) visit(attachment.blendEnable);
+            if (isStatic(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT)) {
+                visit(attachment.srcColorBlendFactor);
+                visit(attachment.dstColorBlendFactor);
+                visit(attachment.colorBlendOp);
+                visit(attachment.srcAlphaBlendFactor);
+                visit(attachment.dstAlphaBlendFactor);
+                visit(attachment.alphaBlendOp);
+            }
+            if (isStatic(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT)) visit(attachment.colorWriteMask);
+        }
+        if (isStatic(VK_DYNAMIC_STATE_BLEND_CONSTANTS)) {
+            for (float blendConstant : colorBlending->blendConstants) {
+                visit(blendConstant);
+            }
+        }
+
+        visit(pipelineInfo.layout);
+        visit(pipelineInfo.renderPass);
+        visit(pipelineInfo.subpass);
+    }
+
+    // Hash of the state visited by visitGraphicsPipelineState, create infos with a different hash never result in identical pipelines
+    size_t hashGraphicsPipelineCreateInfo(const VkGraphicsPipelineCreateInfo& pipelineInfo, const std::vector<CompiledShaderModule>& shaderModules) {
+        size_t hash = 0;
+        visitGraphicsPipelineState(pipelineInfo, shaderModules, [&hash](const auto& value) { hashCombine(hash, value); });
+        return hash;
+    }
+
+    // Serialization of the state visited by visitGraphicsPipelineState, create infos with the same key result in identical pipelines
+    std::string makeGraphicsPipelineKey(const VkGraphicsPipelineCreateInfo& pipelineInfo, const std::vector<CompiledShaderModule>& shaderModules) {
+        std::ostringstream key;
+        key.precision(std::numeric_limits<float>::max_digits10);
+        visitGraphicsPipelineState(pipelineInfo, shaderModules, [&key](const auto& value) { key << value << ';'; });
+        return key.str();
+    }
+
+    // Return the cached pipeline library part for key or compile it from the matching subset of pipelineInfo.
+    // Expects the shader stages of pipelineInfo in the order vertex, fragment
+    VkPipeline getOrCreatePipelineLibrary(std::map<std::string, VkPipeline>* libraries, const std::string& key, VkGraphicsPipelineLibraryFlagsEXT libraryFlags, const VkGraphicsPipelineCreateInfo& pipelineInfo, VkDevice* device) {
+        auto cachedLibrary = libraries->find(key);
+        if (cachedLibrary != libraries->end()) {
+            return cachedLibrary->second;
+        }
+
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+        libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+        libraryInfo.flags = libraryFlags;
+
+        VkGraphicsPipelineCreateInfo libraryPipelineInfo{};
+        libraryPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        libraryPipelineInfo.pNext = &libraryInfo;
+        libraryPipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT; // keep the information needed to optimize the linked pipeline
+        libraryPipelineInfo.pDynamicState = pipelineInfo.pDynamicState;
+        libraryPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        libraryPipelineInfo.basePipelineIndex = -1;
+
+        // only hand over the state belonging to the requested part
+        switch (libraryFlags) {
+        case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+            libraryPipelineInfo.pVertexInputState = pipelineInfo.pVertexInputState;
+            libraryPipelineInfo.pInputAssemblyState = pipelineInfo.pInputAssemblyState;
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+            libraryPipelineInfo.stageCount = 1;
+            libraryPipelineInfo.pStages = &pipelineInfo.pStages[0]; // vertex shader
+            libraryPipelineInfo.pViewportState = pipelineInfo.pViewportState;
+            libraryPipelineInfo.pRasterizationState = pipelineInfo.pRasterizationState;
+            libraryPipelineInfo.layout = pipelineInfo.layout;
+            libraryPipelineInfo.renderPass = pipelineInfo.renderPass;
+            libraryPipelineInfo.subpass = pipelineInfo.subpass;
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+            libraryPipelineInfo.stageCount = 1;
+            libraryPipelineInfo.pStages = &pipelineInfo.pStages[1]; // fragment shader
+            libraryPipelineInfo.pDepthStencilState = pipelineInfo.pDepthStencilState;
+            libraryPipelineInfo.pMultisampleState = pipelineInfo.pMultisampleState;
+            libraryPipelineInfo.layout = pipelineInfo.layout;
+            libraryPipelineInfo.renderPass = pipelineInfo.renderPass;
+            libraryPipelineInfo.subpass = pipelineInfo.subpass;
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+            libraryPipelineInfo.pColorBlendState = pipelineInfo.pColorBlendState;
+            libraryPipelineInfo.pMultisampleState = pipelineInfo.pMultisampleState;
+            libraryPipelineInfo.renderPass = pipelineInfo.renderPass;
+            libraryPipelineInfo.subpass = pipelineInfo.subpass;
+            break;
+        default:
+            throw std::runtime_error("unknown graphics pipeline library part!");
+        }
+
+        VkPipeline library;
+        if (vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, 1, &libraryPipelineInfo, hostAllocator, &library) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline library!");
+        }
+        (*libraries)[key] = library;
+
+        return library;
+    }
+
+    // Link every pipeline from its four library parts (vertex input, pre-rasterization, fragment shader, fragment output).
+    // Parts are only compiled if no pipeline with the same state was created before, all other pipelines only pay for linking
+    // Shader parts are keyed by the code hash of their module, so entries sharing a shader file with different defines get their own library.
+    // Expects shaderModules in the order of pipelineInfo.pStages
+    void linkGraphicsPipelinesFromLibraries(std::vector<VkPipeline>* graphicsPipelines, PipelineLibraryCache* pipelineLibraryCache, std::vector<VkGraphicsPipelineCreateInfo>* pipelineInfos, std::vector<std::vector<CompiledShaderModule>>* shaderModules, VkDevice* device) {
+        graphicsPipelines->resize(pipelineInfos->size());
+
+        for (size_t i = 0; i < pipelineInfos->size(); i++) {
+            const VkGraphicsPipelineCreateInfo& pipelineInfo = pipelineInfos->at(i);
+
+            auto stageCodeHash = [&](VkShaderStageFlagBits stage) {
+                for (uint32_t s = 0; s < pipelineInfo.stageCount; s++) {
+                    if (pipelineInfo.pStages[s].stage == stage) return shaderModules->at(i)[s].codeHash;
+                }
+                throw std::runtime_error("failed to find shader stage for pipeline library!");
+            };
+            auto stageEntryName = [&](VkShaderStageFlagBits stage) {
+                for (uint32_t s = 0; s < pipelineInfo.stageCount; s++) {
+                    if (pipelineInfo.pStages[s].stage == stage) return std::string(pipelineInfo.pStages[s].pName);
+                }
+                throw std::runtime_error("failed to find shader stage for pipeline library!");
+            };
+
+            // state that is set dynamically does not take part in the keys, matching hashGraphicsPipelineCreateInfo
+            const VkPipelineDynamicStateCreateInfo* dynamicStateInfo = pipelineInfo.pDynamicState;
+            std::set<VkDynamicState> dynamicStates(dynamicStateInfo->pDynamicStates, dynamicStateInfo->pDynamicStates + dynamicStateInfo->dynamicStateCount);
+            auto isStatic = [&dynamicStates](VkDynamicState state) { return dynamicStates.count(state) == 0; };
+            auto staticKey = [&isStatic](VkDynamicState state, const auto&... values) { return isStatic(state) ? makePipelineStateKey(values...) : std::string("dynamic;"); };
+
+            const VkPipelineInputAssemblyStateCreateInfo* inputAssembly = pipelineInfo.pInputAssemblyState;
+            std::string vertexInputKey = makePipelineStateKey(isStatic(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT) ? static_cast<int>(inputAssembly->topology) : getTopologyClass(inputAssembly->topology),
+                staticKey(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT, inputAssembly->primitiveRestartEnable));
+
+            const VkPipelineRasterizationStateCreateInfo* rasterizer = pipelineInfo.pRasterizationState;
+            std::string preRasterizationKey = makePipelineStateKey(stageCodeHash(VK_SHADER_STAGE_VERTEX_BIT), stageEntryName(VK_SHADER_STAGE_VERTEX_BIT), rasterizer->depthClampEnable,
+                staticKey(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT, rasterizer->rasterizerDiscardEnable), staticKey(VK_DYNAMIC_STATE_POLYGON_MODE_EXT, rasterizer->polygonMode),
+                staticKey(VK_DYNAMIC_STATE_LINE_WIDTH, rasterizer->lineWidth), staticKey(VK_DYNAMIC_STATE_CULL_MODE_EXT, rasterizer->cullMode), staticKey(VK_DYNAMIC_STATE_FRONT_FACE_EXT, rasterizer->frontFace),
+                staticKey(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT, rasterizer->depthBiasEnable),
+                staticKey(VK_DYNAMIC_STATE_DEPTH_BIAS, rasterizer->depthBiasConstantFactor, rasterizer->depthBiasClamp, rasterizer->depthBiasSlopeFactor));
+
+            const VkPipelineMultisampleStateCreateInfo* multisampling = pipelineInfo.pMultisampleState;
+            std::string multisamplingKey = makePipelineStateKey(multisampling->sampleShadingEnable, multisampling->rasterizationSamples,
+                multisampling->minSampleShading, multisampling->alphaToCoverageEnable, multisampling->alphaToOneEnable);
+
+            const VkPipelineDepthStencilStateCreateInfo* depthStencil = pipelineInfo.pDepthStencilState;
+            std::string fragmentShaderKey = makePipelineStateKey(stageCodeHash(VK_SHADER_STAGE_FRAGMENT_BIT), stageEntryName(VK_SHADER_STAGE_FRAGMENT_BIT),
+                staticKey(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, depthStencil->depthTestEnable), staticKey(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, depthStencil->depthWriteEnable),
+                staticKey(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT, depthStencil->depthCompareOp), staticKey(VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE_EXT, depthStencil->depthBoundsTestEnable),
+                staticKey(VK_DYNAMIC_STATE_DEPTH_BOUNDS, depthStencil->minDepthBounds, depthStencil->maxDepthBounds),
+                staticKey(VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT, depthStencil->stencilTestEnable), multisamplingKey);
+
+            const VkPipelineColorBlendStateCreateInfo* colorBlending = pipelineInfo.pColorBlendState;
+            std::string fragmentOutputKey = makePipelineStateKey(colorBlending->logicOpEnable, colorBlending->logicOp,
+                staticKey(VK_DYNAMIC_STATE_BLEND_CONSTANTS, colorBlending->blendConstants[0], colorBlending->blendConstants[1], colorBlending->blendConstants[2], colorBlending->blendConstants[3]), multisamplingKey);
+            for (uint32_t a = 0; a < colorBlending->attachmentCount; a++) {
+                const VkPipelineColorBlendAttachmentState& attachment = colorBlending->pAttachments[a];
+                fragmentOutputKey += makePipelineStateKey(staticKey(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT, attachment.blendEnable),
+                    staticKey(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT, attachment.srcColorBlendFactor, attachment.dstColorBlendFactor, attachment.colorBlendOp,
+                        attachment.srcAlphaBlendFactor, attachment.dstAlphaBlendFactor, attachment.alphaBlendOp),
+                    staticKey(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT, attachment.colorWriteMask));
+            }
 
-        return shaderText;
-    }
-    // FIXME: remember to add information to use shaderc_combinedd.lib for debug and shaderc_combinedd.lib for release in the linker Input @properties of VS!!
-    // compile shader text into spirv code format
-    shaderc::SpvCompilationResult compileShader(std::string source_text, const char* shader_type){
+            std::array<VkPipeline, 4> libraries = {
+                getOrCreatePipelineLibrary(&pipelineLibraryCache->vertexInputLibraries, vertexInputKey, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, pipelineInfo, device),
+                getOrCreatePipelineLibrary(&pipelineLibraryCache->preRasterizationLibraries, preRasterizationKey, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, pipelineInfo, device),
+                getOrCreatePipelineLibrary(&pipelineLibraryCache->fragmentShaderLibraries, fragmentShaderKey, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, pipelineInfo, device),
+                getOrCreatePipelineLibrary(&pipelineLibraryCache->fragmentOutputLibraries, fragmentOutputKey, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, pipelineInfo, device)
+            };
 
-        shaderc_shader_kind shader_kind;
-        if (strcmp(shader_type, "vertex") == 0) {
-            shader_kind = shaderc_glsl_vertex_shader;
-        } else if (strcmp(shader_type, "fragment") == 0) {
-            shader_kind = shaderc_glsl_fragment_shader;
-        }
-        else {
-            throw std::runtime_error("provided shader type not usable:" + (std::string)shader_type);
+            VkPipelineLibraryCreateInfoKHR linkingInfo{};
+            linkingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+            linkingInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+            linkingInfo.pLibraries = libraries.data();
+
+            VkGraphicsPipelineCreateInfo linkedPipelineInfo{};
+            linkedPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            linkedPipelineInfo.pNext = &linkingInfo;
+            linkedPipelineInfo.flags = 0; // fast linking, add VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT to trade link time for a faster pipeline
+            linkedPipelineInfo.layout = pipelineInfo.layout;
+            linkedPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+            linkedPipelineInfo.basePipelineIndex = -1;
+
+            if (vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, 1, &linkedPipelineInfo, hostAllocator, &graphicsPipelines->at(i)) != VK_SUCCESS) {
+                throw std::runtime_error("failed to link graphics pipeline!");
+            }
         }
+    }
 
-        shaderc::Compiler compiler;
-        shaderc::CompileOptions options;
-        if (GVEProject::REDUCE_SPIRV_CODE_SIZE) {
-            options.SetOptimizationLevel(shaderc_optimization_level_size);
-        }
+    // Measure monolithic pipeline creation against pipeline libraries with an empty cache (compile and link) and a filled cache (link only)
+    void benchmarkPipelineCreationPaths(std::vector<VkGraphicsPipelineCreateInfo>* pipelineInfos, std::vector<std::vector<CompiledShaderModule>>* shaderModules, DeviceCapabilities* deviceCapabilities, VkDevice* device) {
+        std::vector<VkPipeline> pipelines;
+        auto measureMilliseconds = [&](auto createPipelines) {
+            auto startTime = std::chrono::high_resolution_clock::now();
+            createPipelines();
+            double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+            for (VkPipeline pipeline : pipelines) {
+                vkDestroyPipeline(*device, pipeline, hostAllocator);
+            }
+            pipelines.clear();
+            return time;
+        };
 
-        std::cout << "Compiling Shader: " << shader_type << std::endl;
-        shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source_text, shader_kind, shader_type, options);
+        std::cout << "Pipeline creation benchmark (" << pipelineInfos->size() << " pipelines):" << std::endl;
+        std::cout << "\tmonolithic: " << measureMilliseconds([&]() { createMonolithicGraphicsPipelines(&pipelines, pipelineInfos, device); }) << " ms" << std::endl;
 
-        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-            throw std::runtime_error(result.GetErrorMessage());
+        if (!deviceCapabilities->graphicsPipelineLibrary) {
+            std::cout << "\tpipeline libraries: not supported by device" << std::endl;
+            return;
         }
-        std::cout << "Shader compiled: " << shader_type << std::endl;
 
-        return result ;
+        PipelineLibraryCache benchmarkCache;
+        std::cout << "\tpipeline libraries (compile and link): " << measureMilliseconds([&]() { linkGraphicsPipelinesFromLibraries(&pipelines, &benchmarkCache, pipelineInfos, shaderModules, device); }) << " ms" << std::endl;
+        std::cout << "\tpipeline libraries (link only): " << measureMilliseconds([&]() { linkGraphicsPipelinesFromLibraries(&pipelines, &benchmarkCache, pipelineInfos, shaderModules, device); }) << " ms" << std::endl;
+        benchmarkCache.destroy(*device);
     }
 
 
-    // Setup grapics pipeline stages such as shader stage, fixed function stage, pipeline layout and renderpasses
-    void createGraphicsPipelines(std::vector<VkPipeline>* graphicsPipelines, VkRenderPass* renderPass, VkDescriptorSetLayout* descriptorSetLayout,VkPipelineLayout* pipelineLayout, VkExtent2D* swapChainExtent, VkDevice* device) {
+    // Pipeline layout shared by all graphics pipelines, created once as the library parts in pipelineLibraryCache are built against it
+    void createPipelineLayout(VkDescriptorSetLayout* descriptorSetLayout, VkPipelineLayout* pipelineLayout, VkDevice* device) {
 
         //////////////////////// PIPELINE LAYOUT
         // Pipeline layout : the uniform and push values referenced by the shader that can be updated at draw time
@@ -1360,26 +4758,37 @@ private:
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = 1;
         pipelineLayoutInfo.pSetLayouts = descriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-        pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+        // per-object data pushed before each draw, 128 bytes are guaranteed to be available
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(ObjectUniformData);
+
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-        if (vkCreatePipelineLayout(*device, &pipelineLayoutInfo, nullptr, pipelineLayout) != VK_SUCCESS) {
+        if (vkCreatePipelineLayout(*device, &pipelineLayoutInfo, hostAllocator, pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
+    }
+
+    // Setup grapics pipeline stages such as shader stage, fixed function stage and renderpasses
+    void createGraphicsPipelines(std::vector<VkPipeline>* graphicsPipelines, std::vector<VkPipeline>* depthPrePassPipelines, std::vector<uint32_t>* pipelineIndices, PipelineLibraryCache* pipelineLibraryCache, const std::vector<GVEProject::ShaderStageParameters>* pipelineShaders, DeviceCapabilities* deviceCapabilities, VkRenderPass* renderPass, VkPipelineLayout* pipelineLayout, VkExtent2D* swapChainExtent, VkDevice* device) {
 
         //////////////////////// PIPELINE CREATION
 
         std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(GVEProject::PIPELINE_COUNT);
-        graphicsPipelines->resize(GVEProject::PIPELINE_COUNT);
 
         //////////////////////// SHADER STAGE INFOS
         std::vector <VkPipelineShaderStageCreateInfo> vertexShaderStageInfos(GVEProject::PIPELINE_COUNT);
         std::vector <VkPipelineShaderStageCreateInfo> fragmentShaderStageInfos(GVEProject::PIPELINE_COUNT);
         std::vector <VkPipelineVertexInputStateCreateInfo> vertexInputInfos(GVEProject::PIPELINE_COUNT);
-        std::vector<GVEProject::ShaderStageParameters> shaders = GVEProject::PIPELINE_SHADERS;
+        const auto& shaders = *pipelineShaders;
         std::vector<std::vector<VkPipelineShaderStageCreateInfo>> shaderStages(GVEProject::PIPELINE_COUNT);
-        std::vector< std::vector<VkShaderModule>> shaderModules(GVEProject::PIPELINE_COUNT);
-        auto bindingDescription = Vertex::getBindingDescription();
+        std::vector<std::vector<CompiledShaderModule>> shaderModules(GVEProject::PIPELINE_COUNT);
+        std::map<std::string, CompiledShaderModule> shaderModuleCache; // shader permutations used by several pipelines are only compiled once
+        compileShaderPermutations(&shaderModuleCache, pipelineShaders, device);
+        auto bindingDescriptions = Vertex::getBindingDescriptions();
         auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
         //////////////////////// FIXED FUNCTION STAGE INFOS
@@ -1393,17 +4802,17 @@ private:
         std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(GVEProject::PIPELINE_COUNT);
         std::vector<VkPipelineColorBlendStateCreateInfo> colorBlendingInfos(GVEProject::PIPELINE_COUNT);
 
-        std::vector<GVEProject::FixedFunctionStageParameters> parameters = GVEProject::PIPELINE_PARAMETERS;
+        const auto& parameters = GVEProject::PIPELINE_PARAMETERS;
 
 
         for (int i = 0; i < GVEProject::PIPELINE_COUNT; i++) {
             //////////////////////// SHADER STAGE
-            shaderModules[i] = setupShaderStageAndReturnModules(shaders[i], attributeDescriptions, bindingDescription, vertexInputInfos[i], fragmentShaderStageInfos[i], vertexShaderStageInfos[i], device);
+            shaderModules[i] = setupShaderStageAndReturnModules(shaders[i], &shaderModuleCache, attributeDescriptions, bindingDescriptions, vertexInputInfos[i], fragmentShaderStageInfos[i], vertexShaderStageInfos[i]);
             shaderStages[i] = { vertexShaderStageInfos[i], fragmentShaderStageInfos[i] };
 
             //////////////////////// FIXED FUNCTION STAGE
 
-            setupFixedFunctionStage(parameters[i], dynamicStates[i], inputAssemblyInfos[i], dynamicStateInfos[i], viewportStates[i], rasterizerInfos[i], multisamplingInfos[i], depthStencilInfos[i], colorBlendAttachments[i], colorBlendingInfos[i], swapChainExtent);
+            setupFixedFunctionStage(parameters[i], dynamicStates[i], inputAssemblyInfos[i], dynamicStateInfos[i], viewportStates[i], rasterizerInfos[i], multisamplingInfos[i], depthStencilInfos[i], colorBlendAttachments[i], colorBlendingInfos[i], deviceCapabilities, swapChainExtent);
 
             //////////////////////// PIPELINE CREATION
 
@@ -1421,22 +4830,57 @@ private:
             pipelineInfo.pDynamicState = &dynamicStateInfos[i];
             pipelineInfo.layout = *pipelineLayout;
             pipelineInfo.renderPass = *renderPass;
-            pipelineInfo.subpass = 0; // index of the sub pass where this graphics pipeline will be used
+            pipelineInfo.subpass = sceneSubpass; // index of the sub pass where this graphics pipeline will be used
             pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional, specify the handle of an existing pipeline with basePipelineHandle or reference another pipeline that is about to be created by index with basePipelineIndex
             pipelineInfo.basePipelineIndex = -1; // Optional, Right now there is only a single pipeline, so we'll simply specify a null handle and an invalid index. These values are only used if the VK_PIPELINE_CREATE_DERIVATIVE_BIT flag is also specified in the flags field of VkGraphicsPipelineCreateInfo.
 
             pipelineInfos[i] = pipelineInfo;
         }
 
-        if (vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, GVEProject::PIPELINE_COUNT, pipelineInfos.data(), nullptr, graphicsPipelines->data()) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
+        //////////////////////// PIPELINE DEDUPLICATION
+        // pipeline entries resolving to the same create info (apart from dynamic state) share one pipeline, pipelineIndices maps each entry of PIPELINE_PARAMETERS to its pipeline
+
+        std::vector<VkGraphicsPipelineCreateInfo> uniquePipelineInfos;
+        std::vector<std::vector<CompiledShaderModule>> uniqueShaderModules; // shader modules of each unique pipeline, in the order of its pStages
+        std::unordered_map<size_t, std::vector<uint32_t>> pipelineIndicesByHash; // more than one unique pipeline per hash only on hash collisions
+        pipelineIndices->resize(GVEProject::PIPELINE_COUNT);
+        for (int i = 0; i < GVEProject::PIPELINE_COUNT; i++) {
+            std::vector<uint32_t>& hashPipelineIndices = pipelineIndicesByHash[hashGraphicsPipelineCreateInfo(pipelineInfos[i], shaderModules[i])];
+            auto pipelineIndex = std::find_if(hashPipelineIndices.begin(), hashPipelineIndices.end(), [&](uint32_t index) {
+                return makeGraphicsPipelineKey(uniquePipelineInfos[index], uniqueShaderModules[index]) == makeGraphicsPipelineKey(pipelineInfos[i], shaderModules[i]);
+            });
+            if (pipelineIndex != hashPipelineIndices.end()) {
+                pipelineIndices->at(i) = *pipelineIndex;
+                continue;
+            }
+            pipelineIndices->at(i) = static_cast<uint32_t>(uniquePipelineInfos.size());
+            hashPipelineIndices.push_back(pipelineIndices->at(i));
+            uniquePipelineInfos.push_back(pipelineInfos[i]);
+            uniqueShaderModules.push_back(shaderModules[i]);
+        }
+        if (benchmarkPipelineCreation) {
+            std::cout << "Creating " << uniquePipelineInfos.size() << " unique pipelines for " << GVEProject::PIPELINE_COUNT << " pipeline entries" << std::endl;
+        }
+
+        // link pipelines from cached library parts if supported, otherwise fall back to creating every pipeline as a whole
+        if (deviceCapabilities->graphicsPipelineLibrary) {
+            linkGraphicsPipelinesFromLibraries(graphicsPipelines, pipelineLibraryCache, &uniquePipelineInfos, &uniqueShaderModules, device);
+        }
+        else {
+            createMonolithicGraphicsPipelines(graphicsPipelines, &uniquePipelineInfos, device);
+        }
+
+        if (benchmarkPipelineCreation) {
+            benchmarkPipelineCreationPaths(&uniquePipelineInfos, &uniqueShaderModules, deviceCapabilities, device);
+        }
+
+        if (useDepthPrePass) {
+            createDepthPrePassPipelines(depthPrePassPipelines, pipelineIndices, &uniquePipelineInfos, &shaderModuleCache, device);
         }
 
         // destroy shader modules after pipeline is created.
-        for (auto modules : shaderModules) {
-            for (VkShaderModule module : modules) {
-                vkDestroyShaderModule(*device, module, nullptr);
-            }
+        for (auto& module : shaderModuleCache) {
+            vkDestroyShaderModule(*device, module.second.module, hostAllocator);
         }
     };
 };
@@ -1457,10 +4901,10 @@ private:
         // VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without this flag they all have to be reset together
         VkCommandPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // record a command buffer every frame
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // cached command buffers are rerecorded individually when dirty
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-        if (vkCreateCommandPool(*device, &poolInfo, nullptr, commandPool) != VK_SUCCESS) {
+        if (vkCreateCommandPool(*device, &poolInfo, hostAllocator, commandPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create command pool!");
         }
     }
@@ -1475,11 +4919,42 @@ private:
         poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-        if (vkCreateCommandPool(*device, &poolInfo, nullptr, commandPool) != VK_SUCCESS) {
+        if (vkCreateCommandPool(*device, &poolInfo, hostAllocator, commandPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create command pool!");
         }
     }
 
+    // Command pools are externally synchronized, so every recording thread gets its own pool per frame in flight. The pools of a frame
+    // are reset as a whole when the frame starts, so their command buffers don't need to be resettable on their own.
+    void createFrameCommandPools(std::vector<std::vector<VkCommandPool>>* frameCommandPools, DeviceCapabilities* deviceCapabilities, VkDevice* device) {
+        frameCommandPools->resize(GVEProject::MAX_FRAMES_IN_FLIGHT);
+        for (std::vector<VkCommandPool>& framePools : *frameCommandPools) {
+            framePools.resize(recordingThreadCount);
+            for (VkCommandPool& pool : framePools) {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // command buffers are rerecorded every frame
+                poolInfo.queueFamilyIndex = deviceCapabilities->graphicsQueueFamily;
+
+                if (vkCreateCommandPool(*device, &poolInfo, hostAllocator, &pool) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create frame command pool!");
+                }
+            }
+        }
+    }
+
+    // copies of the upload batch are recorded into this pool, it is a second graphics pool without dedicated transfer queue
+    void createTransferCommandPool(VkCommandPool* commandPool, DeviceCapabilities* deviceCapabilities, VkDevice* device) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = deviceCapabilities->transferQueueFamily;
+
+        if (vkCreateCommandPool(*device, &poolInfo, hostAllocator, commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer command pool!");
+        }
+    }
+
     //////////////////////////////////////////////////////////////////////////////
     /*         Section for Window Surfaces, Swap Chains and Image Views         */
     //////////////////////////////////////////////////////////////////////////////
@@ -1512,7 +4987,7 @@ private:
         viewInfo.subresourceRange.layerCount = 1; // for stereoscopic 3D applications, use multiple layers to access views for left and right eye
 
         VkImageView imageView;
-        if (vkCreateImageView(*device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        if (vkCreateImageView(*device, &viewInfo, hostAllocator, &imageView) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture image view!");
         }
 
@@ -1572,7 +5047,7 @@ private:
         createInfo.clipped = VK_TRUE; // enable clipping if hidden pixels are not relevant or should not be read.
         createInfo.oldSwapchain = VK_NULL_HANDLE; // leave for now - resizing windows will create new swapchains based on old ones --> later topic.
 
-        if (vkCreateSwapchainKHR(*device, &createInfo, nullptr, swapchain) != VK_SUCCESS) {
+        if (vkCreateSwapchainKHR(*device, &createInfo, hostAllocator, swapchain) != VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
         }
 
@@ -1615,7 +5090,7 @@ private:
     // VK_PRESENT_MODE_MAILBOX_KHR: new created images replace already present images in the queue if its full, instead of stopping the program to create frames. Reduces latency issues but consumes a lot of energy - don't use on mobile devices.
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentationModes) {
         for (const auto& availablePresentationMode : availablePresentationModes) {
-            if (!GVEProject::SAVE_ENERGY_FOR_MOBILE) {
+            if constexpr (!GVEProject::SAVE_ENERGY_FOR_MOBILE) {
                 if (availablePresentationMode == GVEProject::PRESENTATION_MODE) {
                     return availablePresentationMode;
                 }
@@ -1665,6 +5140,23 @@ private:
         return details;
     }
 
+    // frames and uploads are synchronized with a timeline semaphore, see GpuTimeline. Core in Vulkan 1.2, older devices need VK_KHR_timeline_semaphore
+    bool checkTimelineSemaphoreSupport(VkPhysicalDevice device) {
+        if (!isVulkan12Device(device) && !isDeviceExtensionAvailable(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+            return false;
+        }
+
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+        timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &timelineSemaphoreFeatures;
+        vkGetPhysicalDeviceFeatures2(device, &supportedFeatures);
+
+        return timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+    }
+
     // Querying for swap chain support can actually be omitted, because having a presentation queue implies the presence of a swap chain extension
     bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
         uint32_t extensionCount;
@@ -1683,8 +5175,32 @@ private:
         return requiredExtensions.empty();
     }
 
+    // check for a single optional device extension, required extensions are checked by checkDeviceExtensionSupport
+    bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties>availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // features promoted to Vulkan 1.2 are available without their extension, the instance is created with Vulkan 1.2 as well
+    bool isVulkan12Device(VkPhysicalDevice device) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        return properties.apiVersion >= VK_API_VERSION_1_2;
+    }
+
     void createSurface(VkSurfaceKHR* surface, GLFWwindow* window, VkInstance* instance) {
-        if (glfwCreateWindowSurface(*instance, window, nullptr, surface) != VK_SUCCESS) {
+        if (glfwCreateWindowSurface(*instance, window, hostAllocator, surface) != VK_SUCCESS) {
             throw std::runtime_error("failed to create window surface!");
         }
     }
@@ -1698,6 +5214,9 @@ private:
 
 
         std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentationFamily.value() };
+        if (indices.transferFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
 
         float queuePriority = 1.0f;
        
@@ -1711,7 +5230,8 @@ private:
         }
     }
 
-    void createLogicalDevice(VkSurfaceKHR* surface, VkQueue* presentationQueue, VkQueue* graphicsQueue, VkDevice* device, VkPhysicalDevice* physicalDevice) {
+    // transferQueue is the graphics queue if the device has no dedicated transfer queue family
+    void createLogicalDevice(VkSurfaceKHR* surface, VkQueue* presentationQueue, VkQueue* graphicsQueue, VkQueue* transferQueue, DeviceCapabilities* deviceCapabilities, VkDevice* device, VkPhysicalDevice* physicalDevice) {
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         populateQueueCreateInfo(queueCreateInfos, *surface, physicalDevice);
@@ -1726,14 +5246,202 @@ private:
             }
         }
 
+        // line widths other than 1.0 require the wideLines feature, the width is set dynamically when recording
+        VkPhysicalDeviceFeatures availableFeatures;
+        vkGetPhysicalDeviceFeatures(*physicalDevice, &availableFeatures);
+        for (auto& pipelineParams : GVEProject::PIPELINE_PARAMETERS) {
+            if (pipelineParams.rasterizerInfo_lineWidth != 1.0f && availableFeatures.wideLines == VK_TRUE) {
+                deviceFeatures.wideLines = VK_TRUE;
+            }
+        }
+        deviceCapabilities->wideLines = deviceFeatures.wideLines == VK_TRUE;
+
+        // optional extensions are only enabled if the device supports them and their features, see DeviceCapabilities
+        std::vector<const char*> enabledExtensions = deviceExtensions;
+        auto enableExtension = [&enabledExtensions](const char* extensionName) {
+            for (const char* enabledExtension : enabledExtensions) {
+                if (strcmp(enabledExtension, extensionName) == 0) {
+                    return;
+                }
+            }
+            enabledExtensions.push_back(extensionName);
+        };
+
+        // query optional features by chaining their structs into VkPhysicalDeviceFeatures2, only for available extensions
+        void* supportedFeatureChain = nullptr;
+
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+        graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        bool graphicsPipelineLibraryAvailable = isDeviceExtensionAvailable(*physicalDevice, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) && isDeviceExtensionAvailable(*physicalDevice, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+        if (graphicsPipelineLibraryAvailable) {
+            graphicsPipelineLibraryFeatures.pNext = supportedFeatureChain;
+            supportedFeatureChain = &graphicsPipelineLibraryFeatures;
+        }
+
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+        extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        bool extendedDynamicStateAvailable = isDeviceExtensionAvailable(*physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        if (extendedDynamicStateAvailable) {
+            extendedDynamicStateFeatures.pNext = supportedFeatureChain;
+            supportedFeatureChain = &extendedDynamicStateFeatures;
+        }
+
+        VkPhysicalDeviceExtendedDynamicState2FeaturesEXT extendedDynamicState2Features{};
+        extendedDynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+        bool extendedDynamicState2Available = isDeviceExtensionAvailable(*physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+        if (extendedDynamicState2Available) {
+            extendedDynamicState2Features.pNext = supportedFeatureChain;
+            supportedFeatureChain = &extendedDynamicState2Features;
+        }
+
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features{};
+        extendedDynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        bool extendedDynamicState3Available = isDeviceExtensionAvailable(*physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+        if (extendedDynamicState3Available) {
+            extendedDynamicState3Features.pNext = supportedFeatureChain;
+            supportedFeatureChain = &extendedDynamicState3Features;
+        }
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        bool presentIdAvailable = isDeviceExtensionAvailable(*physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        if (presentIdAvailable) {
+            presentIdFeatures.pNext = supportedFeatureChain;
+            supportedFeatureChain = &presentIdFeatures;
+        }
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        bool presentWaitAvailable = isDeviceExtensionAvailable(*physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        if (presentWaitAvailable) {
+            presentWaitFeatures.pNext = supportedFeatureChain;
+            supportedFeatureChain = &presentWaitFeatures;
+        }
+
+        // features promoted to Vulkan 1.2 are queried and enabled together in one struct
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        bool vulkan12Available = isVulkan12Device(*physicalDevice);
+        if (vulkan12Available) {
+            vulkan12Features.pNext = supportedFeatureChain;
+            supportedFeatureChain = &vulkan12Features;
+        }
+
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = supportedFeatureChain;
+        vkGetPhysicalDeviceFeatures2(*physicalDevice, &supportedFeatures);
+
+        // the queried structs are chained again to enable the features, but only for the capabilities in use
+        void* enabledFeatureChain = nullptr;
+
+        // the used Vulkan 1.2 features, filled in below. It must not be chained together with the structs of the promoted extensions
+        VkPhysicalDeviceVulkan12Features usedVulkan12Features{};
+        usedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        if (vulkan12Available) {
+            usedVulkan12Features.pNext = enabledFeatureChain;
+            enabledFeatureChain = &usedVulkan12Features;
+        }
+
+        // required, checked in isDeviceSuitable
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+        timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+        if (vulkan12Available) {
+            usedVulkan12Features.timelineSemaphore = VK_TRUE;
+        }
+        else {
+            enableExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timelineSemaphoreFeatures.pNext = enabledFeatureChain;
+            enabledFeatureChain = &timelineSemaphoreFeatures;
+        }
+
+        deviceCapabilities->graphicsPipelineLibrary = graphicsPipelineLibraryAvailable && graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+        if (deviceCapabilities->graphicsPipelineLibrary) {
+            enableExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+            enableExtension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+            graphicsPipelineLibraryFeatures.pNext = enabledFeatureChain;
+            enabledFeatureChain = &graphicsPipelineLibraryFeatures;
+        }
+
+        deviceCapabilities->extendedDynamicState = extendedDynamicStateAvailable && extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+        if (deviceCapabilities->extendedDynamicState) {
+            enableExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+            extendedDynamicStateFeatures.pNext = enabledFeatureChain;
+            enabledFeatureChain = &extendedDynamicStateFeatures;
+        }
+
+        deviceCapabilities->extendedDynamicState2 = extendedDynamicState2Available && extendedDynamicState2Features.extendedDynamicState2 == VK_TRUE;
+        if (deviceCapabilities->extendedDynamicState2) {
+            enableExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+            extendedDynamicState2Features.extendedDynamicState2LogicOp = VK_FALSE;
+            extendedDynamicState2Features.extendedDynamicState2PatchControlPoints = VK_FALSE;
+            extendedDynamicState2Features.pNext = enabledFeatureChain;
+            enabledFeatureChain = &extendedDynamicState2Features;
+        }
+
+        deviceCapabilities->extendedDynamicState3PolygonMode = extendedDynamicState3Available && extendedDynamicState3Features.extendedDynamicState3PolygonMode == VK_TRUE;
+        deviceCapabilities->extendedDynamicState3ColorBlend = extendedDynamicState3Available && extendedDynamicState3Features.extendedDynamicState3ColorBlendEnable == VK_TRUE
+            && extendedDynamicState3Features.extendedDynamicState3ColorBlendEquation == VK_TRUE && extendedDynamicState3Features.extendedDynamicState3ColorWriteMask == VK_TRUE;
+        if (deviceCapabilities->extendedDynamicState3PolygonMode || deviceCapabilities->extendedDynamicState3ColorBlend) {
+            enableExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+            VkPhysicalDeviceExtendedDynamicState3FeaturesEXT usedExtendedDynamicState3Features{}; // only enable the used subset of the many extended dynamic state 3 features
+            usedExtendedDynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+            usedExtendedDynamicState3Features.extendedDynamicState3PolygonMode = deviceCapabilities->extendedDynamicState3PolygonMode;
+            usedExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable = deviceCapabilities->extendedDynamicState3ColorBlend;
+            usedExtendedDynamicState3Features.extendedDynamicState3ColorBlendEquation = deviceCapabilities->extendedDynamicState3ColorBlend;
+            usedExtendedDynamicState3Features.extendedDynamicState3ColorWriteMask = deviceCapabilities->extendedDynamicState3ColorBlend;
+            extendedDynamicState3Features = usedExtendedDynamicState3Features;
+            extendedDynamicState3Features.pNext = enabledFeatureChain;
+            enabledFeatureChain = &extendedDynamicState3Features;
+        }
+
+        deviceCapabilities->presentWait = presentIdAvailable && presentWaitAvailable && presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+        if (deviceCapabilities->presentWait) {
+            enableExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enableExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            presentIdFeatures.pNext = enabledFeatureChain;
+            presentWaitFeatures.pNext = &presentIdFeatures;
+            enabledFeatureChain = &presentWaitFeatures;
+        }
+
+        // culled draws select the object data of each visible object with firstInstance
+        bool coreDrawIndirectCount = vulkan12Available && vulkan12Features.drawIndirectCount == VK_TRUE;
+        deviceCapabilities->drawIndirectCount = (coreDrawIndirectCount || isDeviceExtensionAvailable(*physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+            && supportedFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+        if (deviceCapabilities->drawIndirectCount) {
+            if (coreDrawIndirectCount) {
+                usedVulkan12Features.drawIndirectCount = VK_TRUE;
+            }
+            else {
+                enableExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            }
+            deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+        }
+
+        // triangles submitted per frame are counted for benchmarkOcclusionCulling
+        deviceCapabilities->pipelineStatisticsQuery = benchmarkOcclusionCulling && supportedFeatures.features.pipelineStatisticsQuery == VK_TRUE;
+        deviceFeatures.pipelineStatisticsQuery = deviceCapabilities->pipelineStatisticsQuery;
+
+        deviceCapabilities->memoryBudget = isDeviceExtensionAvailable(*physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (deviceCapabilities->memoryBudget) {
+            enableExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
+        VkPhysicalDeviceFeatures2 enabledFeatures{};
+        enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        enabledFeatures.pNext = enabledFeatureChain;
+        enabledFeatures.features = deviceFeatures;
+
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &enabledFeatures; // core features are passed with VkPhysicalDeviceFeatures2 as well, pEnabledFeatures must be null then
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
-        createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = deviceExtensions.size();
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.pEnabledFeatures = nullptr;
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // distinct between instance and device specific validation layers, used for legacy compliance
         if (enableValidationLayers) {
@@ -1744,12 +5452,81 @@ private:
             createInfo.enabledLayerCount = 0;
         }
 
-        if (vkCreateDevice(*physicalDevice, &createInfo, nullptr, device) != VK_SUCCESS) {
+        if (vkCreateDevice(*physicalDevice, &createInfo, hostAllocator, device) != VK_SUCCESS) {
             throw std::runtime_error("failed to create logical device!");
         }
 
-        vkGetDeviceQueue(*device, queueCreateInfos.data()->queueFamilyIndex, 0, graphicsQueue);
-        vkGetDeviceQueue(*device, queueCreateInfos.data()->queueFamilyIndex, 0, presentationQueue);
+        loadDynamicStateFunctions(deviceCapabilities, device);
+
+        QueueFamilyIndices indices = findQueueFamilies(*surface, *physicalDevice);
+        deviceCapabilities->dedicatedTransferQueue = indices.transferFamily.has_value();
+        deviceCapabilities->graphicsQueueFamily = indices.graphicsFamily.value();
+        deviceCapabilities->transferQueueFamily = indices.transferFamily.value_or(indices.graphicsFamily.value());
+
+        vkGetDeviceQueue(*device, indices.graphicsFamily.value(), 0, graphicsQueue);
+        vkGetDeviceQueue(*device, indices.presentationFamily.value(), 0, presentationQueue);
+        vkGetDeviceQueue(*device, deviceCapabilities->transferQueueFamily, 0, transferQueue);
+
+        if (deviceCapabilities->presentWait) {
+            deviceCapabilities->vkWaitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(*device, "vkWaitForPresentKHR");
+        }
+        if (deviceCapabilities->drawIndirectCount) {
+            deviceCapabilities->vkCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCount)vkGetDeviceProcAddr(*device, coreDrawIndirectCount ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirectCountKHR");
+        }
+
+        // timestamps written on the graphics queue are only meaningful if it has valid timestamp bits
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(*physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(*physicalDevice, &queueFamilyCount, queueFamilies.data());
+        if (queueFamilies[deviceCapabilities->graphicsQueueFamily].timestampValidBits > 0) {
+            VkPhysicalDeviceProperties deviceProperties;
+            vkGetPhysicalDeviceProperties(*physicalDevice, &deviceProperties);
+            deviceCapabilities->timestampPeriod = deviceProperties.limits.timestampPeriod;
+        }
+
+        // all pipelines draw into the same attachments, so they rasterize with one sample count
+        VkSampleCountFlagBits requestedSamples = VK_SAMPLE_COUNT_1_BIT;
+        for (const GVEProject::FixedFunctionStageParameters& pipelineParameters : GVEProject::PIPELINE_PARAMETERS) {
+            requestedSamples = std::max(requestedSamples, pipelineParameters.multisamplingInfo_rasterizationSamples);
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(*physicalDevice, &properties);
+        VkSampleCountFlags supportedSamples = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+        deviceCapabilities->msaaSamples = useOcclusionCulling ? VK_SAMPLE_COUNT_1_BIT : requestedSamples; // the depth pyramid is reduced from a single sampled depth attachment
+        while (deviceCapabilities->msaaSamples > VK_SAMPLE_COUNT_1_BIT && (supportedSamples & deviceCapabilities->msaaSamples) == 0) {
+            deviceCapabilities->msaaSamples = static_cast<VkSampleCountFlagBits>(deviceCapabilities->msaaSamples >> 1);
+        }
+        if (deviceCapabilities->msaaSamples != requestedSamples) {
+            std::cerr << "warning: pipelines rasterize with " << static_cast<uint32_t>(deviceCapabilities->msaaSamples) << " instead of " << static_cast<uint32_t>(requestedSamples) << " samples" << std::endl;
+        }
+    }
+
+    // fetch the command entry points of the enabled extended dynamic state extensions
+    void loadDynamicStateFunctions(DeviceCapabilities* deviceCapabilities, VkDevice* device) {
+        if (deviceCapabilities->extendedDynamicState) {
+            deviceCapabilities->vkCmdSetCullModeEXT = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(*device, "vkCmdSetCullModeEXT");
+            deviceCapabilities->vkCmdSetFrontFaceEXT = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(*device, "vkCmdSetFrontFaceEXT");
+            deviceCapabilities->vkCmdSetPrimitiveTopologyEXT = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(*device, "vkCmdSetPrimitiveTopologyEXT");
+            deviceCapabilities->vkCmdSetDepthTestEnableEXT = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetDepthTestEnableEXT");
+            deviceCapabilities->vkCmdSetDepthWriteEnableEXT = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetDepthWriteEnableEXT");
+            deviceCapabilities->vkCmdSetDepthCompareOpEXT = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(*device, "vkCmdSetDepthCompareOpEXT");
+            deviceCapabilities->vkCmdSetDepthBoundsTestEnableEXT = (PFN_vkCmdSetDepthBoundsTestEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetDepthBoundsTestEnableEXT");
+            deviceCapabilities->vkCmdSetStencilTestEnableEXT = (PFN_vkCmdSetStencilTestEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetStencilTestEnableEXT");
+        }
+        if (deviceCapabilities->extendedDynamicState2) {
+            deviceCapabilities->vkCmdSetDepthBiasEnableEXT = (PFN_vkCmdSetDepthBiasEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetDepthBiasEnableEXT");
+            deviceCapabilities->vkCmdSetPrimitiveRestartEnableEXT = (PFN_vkCmdSetPrimitiveRestartEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetPrimitiveRestartEnableEXT");
+            deviceCapabilities->vkCmdSetRasterizerDiscardEnableEXT = (PFN_vkCmdSetRasterizerDiscardEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetRasterizerDiscardEnableEXT");
+        }
+        if (deviceCapabilities->extendedDynamicState3PolygonMode) {
+            deviceCapabilities->vkCmdSetPolygonModeEXT = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(*device, "vkCmdSetPolygonModeEXT");
+        }
+        if (deviceCapabilities->extendedDynamicState3ColorBlend) {
+            deviceCapabilities->vkCmdSetColorBlendEnableEXT = (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(*device, "vkCmdSetColorBlendEnableEXT");
+            deviceCapabilities->vkCmdSetColorBlendEquationEXT = (PFN_vkCmdSetColorBlendEquationEXT)vkGetDeviceProcAddr(*device, "vkCmdSetColorBlendEquationEXT");
+            deviceCapabilities->vkCmdSetColorWriteMaskEXT = (PFN_vkCmdSetColorWriteMaskEXT)vkGetDeviceProcAddr(*device, "vkCmdSetColorWriteMaskEXT");
+        }
     }
 
     ////////////////////////////////////////////////
@@ -1759,6 +5536,7 @@ private:
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentationFamily;
+        std::optional<uint32_t> transferFamily; // optional, queue family without graphics support for uploads
 
         // return true if graphics family and presentation family is set.
         bool isComplete() {
@@ -1796,6 +5574,16 @@ private:
             i++;
         }
 
+        // prefer a transfer-only family (DMA engine) over an async compute family, copies on either overlap with rendering
+        for (uint32_t j = 0; j < queueFamilyCount; j++) {
+            VkQueueFlags queueFlags = queueFamilies[j].queueFlags;
+            if ((queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                if (!indices.transferFamily.has_value() || !(queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                    indices.transferFamily = j;
+                }
+            }
+        }
+
         return indices;
     }
 
@@ -1866,7 +5654,7 @@ private:
 
         QueueFamilyIndices indices = findQueueFamilies(surface, device);
 
-        bool extensionsSupported = checkDeviceExtensionSupport(device);
+        bool extensionsSupported = checkDeviceExtensionSupport(device) && checkTimelineSemaphoreSupport(device);
         bool swapChainAdequate = false;
         
         if (extensionsSupported) {
@@ -1920,7 +5708,7 @@ private:
         // Maximum possible size of textures affects graphics quality
         score += deviceProperties.limits.maxImageDimension2D;
 
-        bool extensionsSupported = checkDeviceExtensionSupport(device);
+        bool extensionsSupported = checkDeviceExtensionSupport(device) && checkTimelineSemaphoreSupport(device);
         bool swapChainAdequate = false;
 
         if (extensionsSupported) {
@@ -1953,7 +5741,7 @@ private:
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(*instance, &deviceCount, devices.data());
 
-        if (GVEProject::CHOOSE_GPU_ON_STARTUP) {
+        if constexpr (GVEProject::CHOOSE_GPU_ON_STARTUP) {
             if (!chooseStartUpGPU(*surface, physicalDevice, devices)) {
                 findBestCandidate(surface, physicalDevice, devices);
                 return;
@@ -2017,7 +5805,7 @@ private:
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
         populateDebugMessengerCreateInfo(createInfo);
  
-        if (CreateDebugUtilsMessengerEXT(*instance, &createInfo, nullptr, debugMessenger) != VK_SUCCESS) {
+        if (CreateDebugUtilsMessengerEXT(*instance, &createInfo, hostAllocator, debugMessenger) != VK_SUCCESS) {
             throw std::runtime_error("failed to set up debug messenger!");
         }
     }
@@ -2035,7 +5823,7 @@ private:
         }
         */
         
-        if (GVEProject::SHOW_VALIDATION_LAYER_DEBUG_INFO) {
+        if constexpr (GVEProject::SHOW_VALIDATION_LAYER_DEBUG_INFO) {
             std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
         }
 
@@ -2060,7 +5848,7 @@ private:
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
-        if (GVEProject::RUN_ON_MACOS) {
+        if constexpr (GVEProject::RUN_ON_MACOS) {
             extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
         }
 
@@ -2131,7 +5919,7 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_2; // 1.1 for vkGetPhysicalDeviceFeatures2, 1.2 for features promoted to core on devices supporting it
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -2141,7 +5929,7 @@ private:
         createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         createInfo.ppEnabledExtensionNames = extensions.data();
 
-        if(GVEProject::RUN_ON_MACOS) createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+        if constexpr (GVEProject::RUN_ON_MACOS) createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
         
         // this debug messenger will be used only for creation and desctruction of Instance and cleaned up afterwards
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
@@ -2157,7 +5945,7 @@ private:
             createInfo.pNext = nullptr;
         }
 
-        if (vkCreateInstance(&createInfo, nullptr, instance) != VK_SUCCESS) {
+        if (vkCreateInstance(&createInfo, hostAllocator, instance) != VK_SUCCESS) {
             throw std::runtime_error("failed to create instance!");
         };
     };
@@ -2172,6 +5960,20 @@ public:
         cleanup();
     }
 
+    // Draw a pipeline entry with another permutation of its shaders, e.g. fragment defines "DEBUG_UV". The graphics pipelines are linked
+    // again with the same layout: known permutations come from the shader cache and unchanged pipeline parts from pipelineLibraryCache,
+    // so mostly the new permutation is compiled. With GVE_EMBEDDED_SHADERS only permutations embedded at build time can be selected.
+    void selectShaderPermutation(uint32_t pipelineEntry, const std::string& vertexShaderDefines, const std::string& fragmentShaderDefines) {
+        setShaderDefines(pipelineEntry, vertexShaderDefines, fragmentShaderDefines);
+
+        vkDeviceWaitIdle(device);
+        destroyGraphicsPipelines();
+        graphicsPipelineCreator->createGraphicsPipelines(&graphicsPipelines, &depthPrePassPipelines, &graphicsPipelineIndices, &pipelineLibraryCache, &pipelineShaders, &deviceCapabilities, &renderPass, &pipelineLayout, &swapChainExtent, &device);
+        if (cacheCommandBuffers) {
+            commandBufferCache.invalidate();
+        }
+    }
+
 private:
     VulkanModelInitializer* modelCreator;
     VulkanDrawingInitializer* drawingCreator;
@@ -2185,7 +5987,12 @@ private:
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
+    DeviceCapabilities deviceCapabilities;
+    DeviceMemoryAllocator deviceMemoryAllocator; // all buffers and images are sub-allocated from its memory blocks
+    StagingRingBuffer stagingRingBuffer; // source of all uploads to device local memory
+    UploadBatch uploadBatch; // records all startup uploads into one submission
     VkQueue graphicsQueue;
+    VkQueue transferQueue; // same as graphicsQueue without dedicated transfer queue
 
     VkSurfaceKHR surface;
     VkQueue presentQueue;
@@ -2200,38 +6007,72 @@ private:
     VkDescriptorSetLayout descriptorSetLayout;
     VkPipelineLayout pipelineLayout;
     std::vector<VkPipeline> graphicsPipelines;
+    std::vector<VkPipeline> depthPrePassPipelines; // useDepthPrePass, per graphics pipeline
+    std::vector<uint32_t> graphicsPipelineIndices; // pipeline of each entry in PIPELINE_PARAMETERS, entries only differing in dynamic state share a pipeline
+    PipelineLibraryCache pipelineLibraryCache; // compiled pipeline parts, kept to link further pipeline variants on demand
+    std::vector<GVEProject::ShaderStageParameters> pipelineShaders; // per pipeline entry, changed by selectShaderPermutation
+    std::vector<std::array<std::string, 2>> pipelineShaderDefines; // vertex and fragment defines per pipeline entry, pipelineShaders points into them
+    std::optional<uint32_t> debugUvToggleEntry; // pipeline entry whose key was pressed, toggled after the current frame
 
     std::vector<VkFramebuffer> swapchainFramebuffers;
-    VkCommandPool commandPool;
+    VkCommandPool commandPool; // cached command buffers and benchmarks
     VkCommandPool shortLivedCommandPool; // for e.g. staging to vertex buffers
+    VkCommandPool transferCommandPool; // copies of uploads on the transfer queue
     std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<std::vector<VkCommandPool>> frameCommandPools; // [frame in flight][recording thread], reset at the start of each frame
+    std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers; // [frame in flight][recording thread]
+    RecordingThreadPool recordingThreads; // recordingThreadCount - 1 workers, the main thread records the first secondary command buffer
+    CommandBufferCache commandBufferCache; // replaces commandBuffers with cacheCommandBuffers
 
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    MemoryAllocation vertexBufferAllocation;
     VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    MemoryAllocation indexBufferAllocation;
+    VkBuffer positionBuffer; // useDepthPrePass
+    MemoryAllocation positionBufferAllocation;
 
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    std::vector<MemoryAllocation> uniformBuffersAllocations;
     std::vector<void*> uniformBuffersMapped;
+    VkDeviceSize objectUniformStride; // distance of the per-object uniform data, see ObjectUniformData
+    std::vector<ObjectUniformData> objectData; // data of every scene object for the current frame
+
+    std::vector<VkBuffer> instanceBuffers;
+    std::vector<MemoryAllocation> instanceBuffersAllocations;
+    std::vector<void*> instanceBuffersMapped;
+    InstancingBenchmark instancingBenchmark; // benchmarkInstancing
+    FrustumCulling frustumCulling; // useGpuCulling
+    OcclusionCullingBenchmark occlusionCullingBenchmark; // benchmarkOcclusionCulling
+    glm::vec4 modelBoundingSphere; // model space, for culling
+    SphereCuller sphereCuller; // useCpuCulling and the CPU fallback of useGpuCulling
+    std::vector<uint32_t> visibleObjects; // scene objects drawn with useCpuCulling
+    std::vector<uint32_t> previousVisibleObjects;
 
     VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> descriptorSets;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
+    GpuTimeline gpuTimeline; // signaled by every submission to the graphics queue
+    std::vector<uint64_t> frameTimelineValues; // timeline value signaled by the latest submission of each frame in flight
+    FramePacer framePacer; // lowLatencyMode
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE; // GPU time of each frame in flight with lowLatencyMode or benchmarkInstancing
+    VkQueryPool pipelineStatisticsQueryPool = VK_NULL_HANDLE; // triangles submitted by each frame in flight with benchmarkOcclusionCulling
     uint32_t currentFrame = 0;
 
     VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    MemoryAllocation textureImageAllocation;
     VkImageView textureImageView;
     VkSampler textureSampler;
 
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
+    MemoryAllocation depthImageAllocation;
     VkImageView depthImageView;
 
+    VkImage colorImage; // multisampled color attachment, only with msaaSamples above 1
+    MemoryAllocation colorImageAllocation;
+    VkImageView colorImageView = VK_NULL_HANDLE;
+
 
     bool framebufferResized = false;
 
@@ -2239,12 +6080,13 @@ private:
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // dont create opengl context
-        if (GVEProject::LOCK_WINDOW_SIZE) glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // disable resizable windows
+        if constexpr (GVEProject::LOCK_WINDOW_SIZE) glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // disable resizable windows
 
 
         window = glfwCreateWindow(GVEProject::WIDTH, GVEProject::HEIGHT, GVEProject::APPLICATION_NAME, nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        glfwSetKeyCallback(window, keyCallback);
     }
 
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -2252,47 +6094,198 @@ private:
         app->framebufferResized = true;
     }
 
+    // number keys 1 to 9 toggle the DEBUG_UV permutation of the fragment shader of the first nine pipeline entries
+    static void keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
+        auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
+        if (action == GLFW_PRESS && key >= GLFW_KEY_1 && key < GLFW_KEY_1 + std::min(GVEProject::PIPELINE_COUNT, 9)) {
+            app->debugUvToggleEntry = static_cast<uint32_t>(key - GLFW_KEY_1);
+        }
+    }
+
+    // the defines of pipelineShaders point into pipelineShaderDefines, which is sized once here so its strings never move
+    void initPipelineShaders() {
+        pipelineShaders.assign(GVEProject::PIPELINE_SHADERS.begin(), GVEProject::PIPELINE_SHADERS.end());
+        pipelineShaderDefines.resize(pipelineShaders.size());
+        for (uint32_t i = 0; i < pipelineShaders.size(); i++) {
+            setShaderDefines(i, pipelineShaders[i].vertexShaderDefines, pipelineShaders[i].fragmentShaderDefines);
+        }
+    }
+
+    // taken by value, the defines may be a copy of the strings they replace
+    void setShaderDefines(uint32_t pipelineEntry, std::string vertexShaderDefines, std::string fragmentShaderDefines) {
+        std::array<std::string, 2>& defines = pipelineShaderDefines.at(pipelineEntry);
+        defines = { std::move(vertexShaderDefines), std::move(fragmentShaderDefines) };
+        pipelineShaders[pipelineEntry].vertexShaderDefines = defines[0].c_str();
+        pipelineShaders[pipelineEntry].fragmentShaderDefines = defines[1].c_str();
+    }
+
+    // Add the DEBUG_UV define of shader.frag to the fragment shader of a pipeline entry or remove it again, keeping its other defines
+    void toggleDebugUvPermutation(uint32_t pipelineEntry) {
+        std::string fragmentShaderDefines;
+        bool debugUv = false;
+        std::stringstream defineStream(pipelineShaderDefines[pipelineEntry][1]);
+        std::string define;
+        while (std::getline(defineStream, define, ';')) {
+            if (define == "DEBUG_UV") {
+                debugUv = true;
+            } else if (!define.empty()) {
+                fragmentShaderDefines += (fragmentShaderDefines.empty() ? "" : ";") + define;
+            }
+        }
+        if (!debugUv) {
+            fragmentShaderDefines += fragmentShaderDefines.empty() ? "DEBUG_UV" : ";DEBUG_UV";
+        }
+
+        std::cout << "Pipeline entry " << pipelineEntry << " fragment shader defines: [" << fragmentShaderDefines << "]" << std::endl;
+        selectShaderPermutation(pipelineEntry, pipelineShaderDefines[pipelineEntry][0], fragmentShaderDefines);
+    }
+
     void initVulkan() {
         instanceCreator->createInstance(&instance);
         instanceCreator->setupDebugMessenger(&debugMessenger, &instance);
 
         presentationDeviceCreator->createSurface(&surface, window, &instance);
         presentationDeviceCreator->pickPhysicalDevice(&surface, &physicalDevice, &instance);
-        presentationDeviceCreator->createLogicalDevice(&surface, &presentQueue, &graphicsQueue, &device, &physicalDevice);
+        presentationDeviceCreator->createLogicalDevice(&surface, &presentQueue, &graphicsQueue, &transferQueue, &deviceCapabilities, &device, &physicalDevice);
+        deviceMemoryAllocator.init(physicalDevice, deviceCapabilities.memoryBudget);
         presentationDeviceCreator->createSwapChain(&swapChainExtent, &swapChainImageFormat, &swapChainImages, &swapchain, &surface, &device, &physicalDevice, window);
         presentationDeviceCreator->createImageViews(&swapchainImageViews, &swapChainImageFormat, &swapChainImages, &device);
 
-        graphicsPipelineCreator->createRenderPass(&renderPass, &swapChainImageFormat, &device, &physicalDevice);
+        graphicsPipelineCreator->createRenderPass(&renderPass, &swapChainImageFormat, &deviceCapabilities, &device, &physicalDevice);
         drawingCreator->createDescriptorSetLayout(&descriptorSetLayout, &device);
-        graphicsPipelineCreator->createGraphicsPipelines(&graphicsPipelines , &renderPass, &descriptorSetLayout, &pipelineLayout, &swapChainExtent, &device);
+        size_t hostAllocationSize = hostAllocationTracker.totalSize();
+        initPipelineShaders();
+        graphicsPipelineCreator->createPipelineLayout(&descriptorSetLayout, &pipelineLayout, &device);
+        graphicsPipelineCreator->createGraphicsPipelines(&graphicsPipelines, &depthPrePassPipelines, &graphicsPipelineIndices, &pipelineLibraryCache, &pipelineShaders, &deviceCapabilities, &renderPass, &pipelineLayout, &swapChainExtent, &device);
+        if (useGpuCulling && deviceCapabilities.drawIndirectCount) {
+            graphicsPipelineCreator->createCullingPipeline(&frustumCulling, &device);
+            if (useOcclusionCulling) {
+                graphicsPipelineCreator->createDepthPyramidPipeline(&frustumCulling.depthPyramid, &device);
+            }
+        }
+        hostAllocationTracker.addMeasurement("pipelines", hostAllocationSize);
         
+        hostAllocationSize = hostAllocationTracker.totalSize();
         presentationDeviceCreator->createCommandPool(&commandPool, &surface, &device, &physicalDevice);
         presentationDeviceCreator->createShortLivedCommandPool(&shortLivedCommandPool, &surface, &device, &physicalDevice);
+        presentationDeviceCreator->createTransferCommandPool(&transferCommandPool, &deviceCapabilities, &device);
+        presentationDeviceCreator->createFrameCommandPools(&frameCommandPools, &deviceCapabilities, &device);
+        hostAllocationTracker.addMeasurement("command pools", hostAllocationSize);
         
-        drawingCreator->createDepthResources(&depthImage, &depthImageMemory, &depthImageView, &swapChainExtent, &device, &physicalDevice);
+        if (deviceCapabilities.msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+            drawingCreator->createColorResources(&colorImage, &colorImageAllocation, &colorImageView, &swapChainImageFormat, &deviceCapabilities, &deviceMemoryAllocator, &swapChainExtent, &device, &physicalDevice);
+        }
+        drawingCreator->createDepthResources(&depthImage, &depthImageAllocation, &depthImageView, &deviceCapabilities, &deviceMemoryAllocator, &swapChainExtent, &device, &physicalDevice);
 
-        drawingCreator->createTextureImage(&textureImageMemory, &textureImage, &commandPool, &graphicsQueue, &device, &physicalDevice);
+        drawingCreator->createStagingRingBuffer(&stagingRingBuffer, &deviceMemoryAllocator, &device, &physicalDevice);
+        drawingCreator->createGpuTimeline(&gpuTimeline, &device);
+        drawingCreator->createUploadBatch(&uploadBatch, &transferCommandPool, &shortLivedCommandPool, &transferQueue, &graphicsQueue, &gpuTimeline, &deviceCapabilities, &device);
+        drawingCreator->beginUploadBatch(&uploadBatch, &stagingRingBuffer, &device);
+        drawingCreator->createTextureImage(&textureImageAllocation, &textureImage, &uploadBatch, &stagingRingBuffer, &deviceMemoryAllocator, &device, &physicalDevice);
         drawingCreator->createTextureImageView(&textureImageView, &textureImage, &device);
         drawingCreator->createTextureSampler(&textureSampler, &device, &physicalDevice);
+        if (useGpuCulling && deviceCapabilities.drawIndirectCount) {
+            drawingCreator->createDepthPyramid(&frustumCulling.depthPyramid, &depthImage, &depthImageView, &uploadBatch, &deviceMemoryAllocator, &swapChainExtent, &device, &physicalDevice);
+        }
 
-        drawingCreator->createFramebuffers(&depthImageView, &swapchainFramebuffers, &swapChainExtent, &swapchainImageViews, &renderPass, &device);
+        drawingCreator->createFramebuffers(&colorImageView, &depthImageView, &swapchainFramebuffers, &swapChainExtent, &swapchainImageViews, &renderPass, &device);
 
         modelCreator->loadModel();
         //modelCreator->moveVertices();
-        drawingCreator->createVertexBuffer(&vertexBufferMemory, &vertexBuffer, &shortLivedCommandPool, &graphicsQueue, &device, &physicalDevice);
-        drawingCreator->createIndexBuffer(&indexBufferMemory, &indexBuffer, &shortLivedCommandPool, &graphicsQueue, &device, &physicalDevice);
-        drawingCreator->createUniformBuffers(&uniformBuffersMapped, &uniformBuffersMemory, &uniformBuffers, &device, &physicalDevice);
+        drawingCreator->createVertexBuffer(&vertexBufferAllocation, &vertexBuffer, &uploadBatch, &stagingRingBuffer, &deviceMemoryAllocator, &device, &physicalDevice);
+        drawingCreator->createIndexBuffer(&indexBufferAllocation, &indexBuffer, &uploadBatch, &stagingRingBuffer, &deviceMemoryAllocator, &device, &physicalDevice);
+        if (useDepthPrePass) {
+            drawingCreator->createPositionBuffer(&positionBufferAllocation, &positionBuffer, &uploadBatch, &stagingRingBuffer, &deviceMemoryAllocator, &device, &physicalDevice);
+        }
+        drawingCreator->submitUploadBatch(&uploadBatch, &stagingRingBuffer);
+        drawingCreator->createUniformBuffers(&uniformBuffersMapped, &uniformBuffersAllocations, &uniformBuffers, &objectUniformStride, &deviceMemoryAllocator, &device, &physicalDevice);
+        drawingCreator->createInstanceBuffers(&instanceBuffersMapped, &instanceBuffersAllocations, &instanceBuffers, &deviceMemoryAllocator, &device, &physicalDevice);
+        modelBoundingSphere = drawingCreator->getModelBoundingSphere();
+        if (useGpuCulling) {
+            drawingCreator->createFrustumCulling(&frustumCulling, modelBoundingSphere, &uniformBuffers, &instanceBuffers, &deviceCapabilities, &deviceMemoryAllocator, &device, &physicalDevice);
+        }
         
+        hostAllocationSize = hostAllocationTracker.totalSize();
         drawingCreator->createDescriptorPool(&descriptorPool, &device);
-        drawingCreator->createDescriptorSets(&textureSampler, &textureImageView, &descriptorSets, &descriptorPool, &descriptorSetLayout, &uniformBuffers, &device);
-        drawingCreator->createCommandBuffers(&commandBuffers, &commandPool, &device);
-        drawingCreator->createSyncObjects(&imageAvailableSemaphores, &renderFinishedSemaphores, &inFlightFences, &device);
+        drawingCreator->createDescriptorSets(&textureSampler, &textureImageView, &descriptorSets, &descriptorPool, &descriptorSetLayout, &uniformBuffers, objectUniformStride, &device);
+        hostAllocationTracker.addMeasurement("descriptor pool and sets", hostAllocationSize);
+        hostAllocationSize = hostAllocationTracker.totalSize();
+        drawingCreator->createCommandBuffers(&commandBuffers, &frameCommandPools, &device);
+        if (recordingThreadCount > 1) {
+            drawingCreator->createSecondaryCommandBuffers(&secondaryCommandBuffers, &frameCommandPools, &device);
+            recordingThreads.start(recordingThreadCount - 1);
+        }
+        if (cacheCommandBuffers) {
+            drawingCreator->createCommandBufferCache(&commandBufferCache, static_cast<uint32_t>(swapChainImages.size()), &commandPool, &device);
+        }
+        hostAllocationTracker.addMeasurement("command buffers", hostAllocationSize);
+        drawingCreator->createSyncObjects(&imageAvailableSemaphores, &renderFinishedSemaphores, &frameTimelineValues, &device);
+        if ((lowLatencyMode || benchmarkInstancing) && deviceCapabilities.timestampPeriod > 0.0f) {
+            drawingCreator->createTimestampQueryPool(&timestampQueryPool, &device);
+        }
+        if (benchmarkOcclusionCulling && deviceCapabilities.pipelineStatisticsQuery) {
+            drawingCreator->createPipelineStatisticsQueryPool(&pipelineStatisticsQueryPool, &device);
+        }
+        if (lowLatencyMode) {
+            const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+            if (videoMode != nullptr && videoMode->refreshRate > 0) {
+                framePacer.refreshMilliseconds = 1000.0 / videoMode->refreshRate;
+            }
+        }
+
+        if (benchmarkPerObjectData) {
+            drawingCreator->benchmarkPerObjectDataPaths(&descriptorSets, &uniformBuffersMapped, objectUniformStride, graphicsPipelines[0], &renderPass, swapchainFramebuffers[0], &swapChainExtent, &pipelineLayout, &commandPool, &device);
+        }
+        if (benchmarkParallelRecording) {
+            std::vector<VkCommandBuffer> noSecondaryCommandBuffers;
+            drawingCreator->benchmarkParallelRecordingPaths(&frameCommandPools[0], recordingThreadCount > 1 ? &secondaryCommandBuffers[0] : &noSecondaryCommandBuffers, &recordingThreads, &descriptorSets, objectUniformStride, &indexBuffer, &vertexBuffer, instanceBuffers[0], &frustumCulling, &graphicsPipelines, &graphicsPipelineIndices, &deviceCapabilities, &renderPass, swapchainFramebuffers[0], &swapChainExtent, &pipelineLayout, &commandPool, &device);
+        }
+        if (benchmarkCpuCulling) {
+            glm::mat4 viewProjection;
+            drawingCreator->updateUniformBuffer(0, &uniformBuffersMapped, &instanceBuffersMapped, objectUniformStride, &objectData, &viewProjection, &swapChainExtent); // camera of the first frame, no frame is in flight yet
+            drawingCreator->benchmarkCpuCullingPaths(viewProjection);
+        }
+        if (benchmarkOcclusionCulling) {
+            std::cout << "Occlusion culling benchmark (" << sceneObjectCount << " objects, " << indices.size() / 3 << " triangles per object):" << std::endl;
+        }
+        if (benchmarkInstancing) {
+            std::cout << "Instancing benchmark (" << graphicsPipelineIndices.size() << " instanced draws per frame, " << indices.size() / 3 << " triangles per instance):" << std::endl;
+        }
+
+        if (printMemoryStatistics) {
+            deviceMemoryAllocator.printStatistics();
+        }
+        if (printMemoryBudget) {
+            deviceMemoryAllocator.printBudget();
+        }
+        if (printHostAllocationStatistics) {
+            hostAllocationTracker.printStatistics();
+        }
     }
 
     void mainLoop() {
+        auto lastBudgetReport = std::chrono::steady_clock::now();
         while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            if (!lowLatencyMode) {
+                glfwPollEvents(); // polled as late as possible within drawFrame otherwise
+            }
             drawFrame();
+
+            if (debugUvToggleEntry) {
+                toggleDebugUvPermutation(*debugUvToggleEntry);
+                debugUvToggleEntry.reset();
+            }
+
+            if ((printMemoryBudget || lowLatencyMode) && std::chrono::steady_clock::now() - lastBudgetReport > std::chrono::seconds(5)) {
+                if (printMemoryBudget) {
+                    deviceMemoryAllocator.updateBudget();
+                    deviceMemoryAllocator.printBudget();
+                }
+                if (lowLatencyMode) {
+                    framePacer.printStatistics(deviceCapabilities.presentWait);
+                }
+                lastBudgetReport = std::chrono::steady_clock::now();
+            }
         }
 
         vkDeviceWaitIdle(device);
@@ -2312,15 +6305,34 @@ private:
 
         presentationDeviceCreator->createSwapChain(&swapChainExtent, &swapChainImageFormat, &swapChainImages, &swapchain, &surface, &device, &physicalDevice, window);
         presentationDeviceCreator->createImageViews(&swapchainImageViews, &swapChainImageFormat, &swapChainImages, &device); // Image Views are based directly on the swap chain images
-        drawingCreator->createDepthResources(&depthImage, &depthImageMemory, &depthImageView, &swapChainExtent, &device, &physicalDevice);
+        if (deviceCapabilities.msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+            drawingCreator->createColorResources(&colorImage, &colorImageAllocation, &colorImageView, &swapChainImageFormat, &deviceCapabilities, &deviceMemoryAllocator, &swapChainExtent, &device, &physicalDevice);
+        }
+        drawingCreator->createDepthResources(&depthImage, &depthImageAllocation, &depthImageView, &deviceCapabilities, &deviceMemoryAllocator, &swapChainExtent, &device, &physicalDevice);
+        if (frustumCulling.depthPyramid.image != VK_NULL_HANDLE) { // the depth pyramid is sized after and reduced from the depth attachment
+            frustumCulling.depthPyramid.destroyImage(device, &deviceMemoryAllocator);
+            drawingCreator->beginUploadBatch(&uploadBatch, &stagingRingBuffer, &device);
+            drawingCreator->createDepthPyramid(&frustumCulling.depthPyramid, &depthImage, &depthImageView, &uploadBatch, &deviceMemoryAllocator, &swapChainExtent, &device, &physicalDevice);
+            drawingCreator->submitUploadBatch(&uploadBatch, &stagingRingBuffer);
+            drawingCreator->updateDepthPyramidDescriptors(&frustumCulling, &device);
+        }
         //drawingCreator->createTextureImageView(&textureImageView, &textureImage, &device);
-        drawingCreator->createFramebuffers(&depthImageView, &swapchainFramebuffers, &swapChainExtent, &swapchainImageViews, &renderPass, &device); // framebuffers directly depend on the swap chain images
-
+        drawingCreator->createFramebuffers(&colorImageView, &depthImageView, &swapchainFramebuffers, &swapChainExtent, &swapchainImageViews, &renderPass, &device); // framebuffers directly depend on the swap chain images
+        framePacer.swapchainRecreated();
+        if (cacheCommandBuffers) {
+            drawingCreator->createCommandBufferCache(&commandBufferCache, static_cast<uint32_t>(swapChainImages.size()), &commandPool, &device); // recorded with the old framebuffers and extent
+        }
     }
 
     void drawFrame() {
         // wait for previous frame to finish, so that the command buffer and semaphores are available to use
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        // with fewer effective frames in flight, wait for a more recent frame to limit the work queued ahead of the display
+        uint32_t framesInFlight = lowLatencyMode ? framePacer.framesInFlight : GVEProject::MAX_FRAMES_IN_FLIGHT;
+        gpuTimeline.wait(frameTimelineValues[(currentFrame + GVEProject::MAX_FRAMES_IN_FLIGHT - framesInFlight) % GVEProject::MAX_FRAMES_IN_FLIGHT], device);
+
+        if (lowLatencyMode) {
+            paceFrame(framesInFlight);
+        }
 
         uint32_t imageIndex; // use index to pick the framebuffer
         VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -2336,32 +6348,91 @@ private:
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
-        drawingCreator->updateUniformBuffer(currentFrame, &uniformBuffersMapped, &swapChainExtent);
+        auto inputTime = std::chrono::steady_clock::now();
+        if (lowLatencyMode) {
+            glfwPollEvents();
+        }
+        glm::mat4 viewProjection;
+        drawingCreator->updateUniformBuffer(currentFrame, &uniformBuffersMapped, &instanceBuffersMapped, objectUniformStride, &objectData, &viewProjection, &swapChainExtent);
+        if (useCpuCulling || (useGpuCulling && !deviceCapabilities.drawIndirectCount)) {
+            bool visibleObjectsChanged = drawingCreator->cullObjectsOnCpu(currentFrame, &objectData, viewProjection, modelBoundingSphere, &sphereCuller, &visibleObjects, &previousVisibleObjects, &instanceBuffersMapped, &frustumCulling);
+            // the draws of the visible objects are recorded with useCpuCulling
+            if (useCpuCulling && cacheCommandBuffers && visibleObjectsChanged) {
+                commandBufferCache.invalidate();
+            }
+        }
+
+        if (benchmarkOcclusionCulling) {
+            // the statistics of this frame in flight were written by its previous submission, which completed before the wait above
+            uint64_t triangles;
+            if (pipelineStatisticsQueryPool != VK_NULL_HANDLE && frameTimelineValues[currentFrame] != 0 && drawingCreator->readFrameSubmittedTriangles(currentFrame, pipelineStatisticsQueryPool, &triangles, &device)) {
+                occlusionCullingBenchmark.addMeasurement(triangles);
+            }
+            occlusionCullingBenchmark.addFrame();
+            if (occlusionCullingBenchmark.advance() && cacheCommandBuffers) {
+                commandBufferCache.invalidate();
+            }
+            frustumCulling.parameters.occlusionCulling = occlusionCullingBenchmark.occlusionCulling;
+        }
 
-        // reset fence to unsignaled after wating
-        // only reset fence if work is submitted
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        uint32_t instanceCount = sceneObjectCount;
+        if (benchmarkInstancing) {
+            // the timestamps of this frame in flight were written by its previous submission, which completed before the wait above
+            double gpuMilliseconds;
+            if (timestampQueryPool != VK_NULL_HANDLE && frameTimelineValues[currentFrame] != 0 && drawingCreator->readFrameGpuMilliseconds(currentFrame, timestampQueryPool, &gpuMilliseconds, &deviceCapabilities, &device)) {
+                instancingBenchmark.addGpuMeasurement(gpuMilliseconds);
+            }
+            if (instancingBenchmark.advance(sceneObjectCount) && cacheCommandBuffers) {
+                commandBufferCache.invalidate();
+            }
+            instanceCount = instancingBenchmark.instanceCount;
+        }
 
-        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-        drawingCreator->recordCommandBuffer(currentFrame, imageIndex, &descriptorSets, &indexBuffer, &vertexBuffer, &commandBuffers[currentFrame], &commandPool, &graphicsPipelines, &renderPass, &pipelineLayout, &swapchainFramebuffers, &swapChainExtent, &device);
+        // cached command buffers are only recorded when dirty, their secondary command buffers would be re-recorded by other frames
+        auto recordingStartTime = std::chrono::steady_clock::now();
+        VkCommandBuffer* commandBuffer = &commandBuffers[currentFrame];
+        if (!cacheCommandBuffers) {
+            drawingCreator->resetFrameCommandPools(&frameCommandPools[currentFrame], &device);
+            drawingCreator->recordCommandBuffer(currentFrame, imageIndex, instanceCount, &visibleObjects, &descriptorSets, &objectData, objectUniformStride, &indexBuffer, &vertexBuffer, &positionBuffer, &instanceBuffers, &frustumCulling, commandBuffer, recordingThreadCount > 1 ? &secondaryCommandBuffers[currentFrame] : nullptr, &recordingThreads, timestampQueryPool, pipelineStatisticsQueryPool, &graphicsPipelines, &depthPrePassPipelines, &graphicsPipelineIndices, &deviceCapabilities, &renderPass, &pipelineLayout, &swapchainFramebuffers, &swapChainExtent, &device);
+        }
+        else {
+            commandBuffer = commandBufferCache.get(currentFrame, imageIndex);
+            if (commandBufferCache.isDirty(currentFrame, imageIndex)) {
+                vkResetCommandBuffer(*commandBuffer, 0);
+                drawingCreator->recordCommandBuffer(currentFrame, imageIndex, instanceCount, &visibleObjects, &descriptorSets, &objectData, objectUniformStride, &indexBuffer, &vertexBuffer, &positionBuffer, &instanceBuffers, &frustumCulling, commandBuffer, nullptr, &recordingThreads, timestampQueryPool, pipelineStatisticsQueryPool, &graphicsPipelines, &depthPrePassPipelines, &graphicsPipelineIndices, &deviceCapabilities, &renderPass, &pipelineLayout, &swapchainFramebuffers, &swapChainExtent, &device);
+                commandBufferCache.markRecorded(currentFrame, imageIndex);
+            }
+        }
+        if (benchmarkInstancing && !instancingBenchmark.finished) {
+            instancingBenchmark.addFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordingStartTime).count());
+        }
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
         VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
         VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }; // specify stage of graphics pipeline that writes colore attachment: wait with writing colors to the image until it's available
-        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame], gpuTimeline.semaphore };
 
+        // the value of the binary semaphore is ignored
+        frameTimelineValues[currentFrame] = gpuTimeline.nextValue();
+        uint64_t signalValues[] = { 0, frameTimelineValues[currentFrame] };
+        VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+        timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineSubmitInfo.signalSemaphoreValueCount = 2;
+        timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+        submitInfo.pNext = &timelineSubmitInfo;
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pCommandBuffers = commandBuffer;
+        submitInfo.signalSemaphoreCount = 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         // submit command buffer to graphics queue
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
 
@@ -2369,13 +6440,27 @@ private:
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
         VkSwapchainKHR swapchains[] = { swapchain };
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapchains;
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr; // Optional, allows to specify an array of VkResult values to check for every individual swap chain if presentation was successful.
+
+        // identify the present to wait for it in later frames
+        VkPresentIdKHR presentIdInfo{};
+        if (lowLatencyMode) {
+            framePacer.addMeasurement(&framePacer.cpuMilliseconds, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inputTime).count());
+            framePacer.presentId++;
+            framePacer.pendingFrames.push_back(FramePacer::PendingFrame{ framePacer.presentId, frameTimelineValues[currentFrame], inputTime });
+            if (deviceCapabilities.presentWait) {
+                presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+                presentIdInfo.swapchainCount = 1;
+                presentIdInfo.pPresentIds = &framePacer.presentId;
+                presentInfo.pNext = &presentIdInfo;
+            }
+        }
     
         result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
@@ -2389,23 +6474,48 @@ private:
         currentFrame = (currentFrame + 1) % GVEProject::MAX_FRAMES_IN_FLIGHT; // use modulo to  ensure that the frame index loops around after every MAX_FRAMES_IN_FLIGHT enqueued frames.
     }
 
+    // Called once the frame submitted framesInFlight frames ago completed: measure its latency and GPU time, wait until the present
+    // of that frame is visible and adapt the frames in flight. The GPU time is read for the frame in flight about to be reused.
+    void paceFrame(uint32_t framesInFlight) {
+        if (deviceCapabilities.presentWait) {
+            uint64_t waitPresentId = framePacer.presentId - (framesInFlight - 1);
+            if (framePacer.presentId >= framesInFlight && waitPresentId >= framePacer.firstSwapchainPresentId) {
+                // the timeout keeps a minimized or occluded window from stalling, errors such as out of date are handled by acquiring
+                VkResult result = deviceCapabilities.vkWaitForPresentKHR(device, swapchain, waitPresentId, 100000000);
+                if (result == VK_SUCCESS) {
+                    framePacer.measureLatency([waitPresentId](const FramePacer::PendingFrame& frame) { return frame.presentId <= waitPresentId; });
+                }
+            }
+        }
+        else {
+            framePacer.measureLatency([this](const FramePacer::PendingFrame& frame) { return gpuTimeline.isComplete(frame.timelineValue, device); });
+        }
+
+        // the queries of a frame in flight are only reset by its first submission
+        double gpuMilliseconds;
+        if (timestampQueryPool != VK_NULL_HANDLE && frameTimelineValues[currentFrame] != 0 && drawingCreator->readFrameGpuMilliseconds(currentFrame, timestampQueryPool, &gpuMilliseconds, &deviceCapabilities, &device)) {
+            framePacer.addMeasurement(&framePacer.gpuMilliseconds, gpuMilliseconds);
+        }
+        framePacer.adaptFramesInFlight();
+    }
+
     void cleanupGlfw() {
         glfwDestroyWindow(window);
         glfwTerminate();
     }
 
     void cleanupInstances() {
-        vkDestroyInstance(instance, nullptr);
+        vkDestroyInstance(instance, hostAllocator);
     }
 
     void cleanupDebugMessengers() {
         if (enableValidationLayers) {
-            instanceCreator->DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+            instanceCreator->DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator);
         }
     }
 
     void cleanupSurfaces() {
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        vkDestroySurfaceKHR(instance, surface, hostAllocator);
     }
 
     void cleanupDevices() {
@@ -2414,90 +6524,136 @@ private:
         // 
         // Nothing to do for device queues. 
         // Will be destroyed on logical device destruction.
-        vkDestroyDevice(device, nullptr);
+        vkDestroyDevice(device, hostAllocator);
     }
 
     // Swapchain cleanup for each swapchain recreation and at the end of application.
     void cleanupSwapchain() {
+        cleanupColorResources();
         cleanupDepthResources();
         cleanupFramebuffers();
         cleanupImageViews();
 
-        vkDestroySwapchainKHR(device, swapchain, nullptr);
+        vkDestroySwapchainKHR(device, swapchain, hostAllocator);
     }
 
     void cleanupImageViews() {
         for (auto imageView : swapchainImageViews) {
-            vkDestroyImageView(device, imageView, nullptr);
+            vkDestroyImageView(device, imageView, hostAllocator);
         }
     }
 
-    void cleanupGraphicsPipeline() {
+    void destroyGraphicsPipelines() {
         for (auto pipeline : graphicsPipelines) {
-            vkDestroyPipeline(device, pipeline, nullptr);
+            vkDestroyPipeline(device, pipeline, hostAllocator);
+        }
+        for (auto pipeline : depthPrePassPipelines) {
+            if (pipeline != VK_NULL_HANDLE) {
+                vkDestroyPipeline(device, pipeline, hostAllocator);
+            }
         }
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        vkDestroyRenderPass(device, renderPass, nullptr);
+        graphicsPipelines.clear();
+        depthPrePassPipelines.clear();
+    }
+
+    void cleanupGraphicsPipeline() {
+        destroyGraphicsPipelines();
+        pipelineLibraryCache.destroy(device);
+        vkDestroyPipelineLayout(device, pipelineLayout, hostAllocator);
+        vkDestroyRenderPass(device, renderPass, hostAllocator);
     }
 
     void cleanupFramebuffers() {
         for (auto framebuffer : swapchainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+            vkDestroyFramebuffer(device, framebuffer, hostAllocator);
         }
     }
 
     void cleanupCommandPools() {
-        vkDestroyCommandPool(device, commandPool, nullptr);
-        vkDestroyCommandPool(device, shortLivedCommandPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, hostAllocator);
+        vkDestroyCommandPool(device, shortLivedCommandPool, hostAllocator);
+        vkDestroyCommandPool(device, transferCommandPool, hostAllocator);
+        for (std::vector<VkCommandPool>& framePools : frameCommandPools) {
+            for (VkCommandPool pool : framePools) {
+                vkDestroyCommandPool(device, pool, hostAllocator);
+            }
+        }
         //no commandbuffer cleanup needed, they are freed when commandpool is deleted.
     }
 
     void cleanupSyncObjects() {
         for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
+            vkDestroySemaphore(device, renderFinishedSemaphores[i], hostAllocator);
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], hostAllocator);
+        }
+        vkDestroySemaphore(device, gpuTimeline.semaphore, hostAllocator);
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, timestampQueryPool, hostAllocator);
         }
+        if (pipelineStatisticsQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, pipelineStatisticsQueryPool, hostAllocator);
+        }
+        vkDestroySemaphore(device, uploadBatch.transferCompleteSemaphore, hostAllocator);
     }
 
     void cleanupBuffers() {
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkDestroyBuffer(device, indexBuffer, nullptr);
+        vkDestroyBuffer(device, vertexBuffer, hostAllocator);
+        vkDestroyBuffer(device, indexBuffer, hostAllocator);
+        if (useDepthPrePass) {
+            vkDestroyBuffer(device, positionBuffer, hostAllocator);
+        }
     }
     void cleanupMemory() {
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
-        vkFreeMemory(device, indexBufferMemory, nullptr);
+        stagingRingBuffer.destroy(device, &deviceMemoryAllocator);
+        deviceMemoryAllocator.free(vertexBufferAllocation, device);
+        deviceMemoryAllocator.free(indexBufferAllocation, device);
+        if (useDepthPrePass) {
+            deviceMemoryAllocator.free(positionBufferAllocation, device);
+        }
 
         for (size_t i = 0; i < GVEProject::MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+            vkDestroyBuffer(device, uniformBuffers[i], hostAllocator);
+            deviceMemoryAllocator.free(uniformBuffersAllocations[i], device);
+            vkDestroyBuffer(device, instanceBuffers[i], hostAllocator);
+            deviceMemoryAllocator.free(instanceBuffersAllocations[i], device);
         }
+        frustumCulling.destroy(device, &deviceMemoryAllocator);
 
-        vkFreeMemory(device, textureImageMemory, nullptr);
+        deviceMemoryAllocator.free(textureImageAllocation, device);
     }
 
     void cleanupDescriptors() {
-        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, hostAllocator);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostAllocator);
         //no descriptor set cleanup needed, they are freed when descriptor pool is deleted.
     }
 
     void cleanupImages() {
-        vkDestroyImage(device, textureImage, nullptr);
+        vkDestroyImage(device, textureImage, hostAllocator);
     }
 
     void cleanupTextureResources() {
-        vkDestroySampler(device, textureSampler, nullptr);
-        vkDestroyImageView(device, textureImageView, nullptr);
+        vkDestroySampler(device, textureSampler, hostAllocator);
+        vkDestroyImageView(device, textureImageView, hostAllocator);
+    }
+
+    void cleanupColorResources() {
+        if (colorImageView != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, colorImageView, hostAllocator);
+            vkDestroyImage(device, colorImage, hostAllocator);
+            deviceMemoryAllocator.free(colorImageAllocation, device);
+            colorImageView = VK_NULL_HANDLE;
+        }
     }
 
     void cleanupDepthResources() {
-        vkDestroyImageView(device, depthImageView, nullptr);
-        vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthImageMemory, nullptr);
+        vkDestroyImageView(device, depthImageView, hostAllocator);
+        vkDestroyImage(device, depthImage, hostAllocator);
+        deviceMemoryAllocator.free(depthImageAllocation, device);
     }
 
     void cleanup() {
+        recordingThreads.stop();
         cleanupSyncObjects();
         cleanupCommandPools();
         //cleanupFramebuffers(); // not needed, will be done in cleanup swapchain.
@@ -2509,6 +6665,7 @@ private:
         cleanupTextureResources();
         cleanupSwapchain();
         cleanupImages();
+        deviceMemoryAllocator.destroy(device); // free the memory blocks once all resources are destroyed
         cleanupDevices();
         cleanupSurfaces();
         cleanupDebugMessengers();
@@ -0,0 +1,146 @@
+"""
+Pre-build step of the VulkanProject: compiles all shader permutations (shader file plus preprocessor defines) listed in
+GraphicalVulkanEditorProjectVariables.h to SPIR-V and embeds them as constexpr uint32_t arrays into EmbeddedShaders.h. With GVE_EMBEDDED_SHADERS defined, the application
+creates its shader modules from these arrays and neither reads shader files nor links shaderc at runtime.
+
+Usage: python embed_shaders.py [project header] [output header]
+glslc is taken from the Vulkan SDK (VULKAN_SDK environment variable) or from PATH.
+"""
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+SCRIPT_DIRECTORY = os.path.dirname(os.path.abspath(__file__))
+PROJECT_HEADER_LOCATION = os.path.join(SCRIPT_DIRECTORY, "..", "..", "GraphicalVulkanEditorProjectVariables.h")
+EMBEDDED_SHADERS_OUTPUT_LOCATION = os.path.join(SCRIPT_DIRECTORY, "..", "..", "EmbeddedShaders.h")
+
+SHADER_STAGES = {"vertex": "vert", "fragment": "frag", "compute": "comp"}
+
+
+def findGlslc():
+    """
+    Returns the path of the glslc compiler, preferring the one shipped with the Vulkan SDK.
+    """
+    vulkanSdk = os.environ.get("VULKAN_SDK")
+    if vulkanSdk:
+        for binDirectory in ("Bin", "bin"):
+            for executable in ("glslc.exe", "glslc"):
+                candidate = os.path.join(vulkanSdk, binDirectory, executable)
+                if os.path.isfile(candidate):
+                    return candidate
+    glslc = shutil.which("glslc")
+    if glslc is None:
+        raise RuntimeError("glslc not found, install the Vulkan SDK or add glslc to PATH")
+    return glslc
+
+
+def readProjectShaders(headerContent: str):
+    """
+    Collects the shader permutations of all pipelines and the standalone shaders (e.g. compute shaders) in the project header.
+
+    Returns:
+        list: (shader file, shader type, shader defines) tuples without duplicates, in order of appearance.
+    """
+    shaders = []
+    for stageParameters in re.findall(r"ShaderStageParameters \w+\s*\{(.*?)\};", headerContent, re.DOTALL):
+        values = dict((name, value) for value, name in re.findall(r'"([^"]*)",?\s*// (\w+)', stageParameters))
+        for shaderType in ("vertex", "fragment"):
+            shader = (values[f"{shaderType}ShaderText"], shaderType, values.get(f"{shaderType}ShaderDefines", ""))
+            if shader not in shaders:
+                shaders.append(shader)
+    for shaderFile, shaderType in re.findall(r'"([^"]*)";\s*// (\w+)ShaderText', headerContent):
+        shader = (shaderFile, shaderType, "")
+        if shader not in shaders:
+            shaders.append(shader)
+    return shaders
+
+
+def compileShader(glslc: str, shaderFile: str, shaderType: str, shaderDefines: str, reduceCodeSize: bool):
+    """
+    Compiles a GLSL shader file with glslc, shaderDefines is a semicolon separated list such as "DEBUG_UV;SCALE=2".
+
+    Returns:
+        list: SPIR-V code as 32 bit words.
+    """
+    with tempfile.TemporaryDirectory() as outputDirectory:
+        outputFile = os.path.join(outputDirectory, "shader.spv")
+        command = [glslc, f"-fshader-stage={SHADER_STAGES[shaderType]}", shaderFile, "-o", outputFile]
+        if reduceCodeSize:
+            command.insert(1, "-Os")
+        command[1:1] = [f"-D{define}" for define in shaderDefines.split(";") if define]
+        subprocess.run(command, check=True)
+        with open(outputFile, "rb") as spirvFile:
+            code = spirvFile.read()
+
+    return [int.from_bytes(code[i:i + 4], "little") for i in range(0, len(code), 4)]
+
+
+def writeEmbeddedShadersHeader(shaders: list, reduceCodeSize: bool, outputLocation: str):
+    """
+    Compiles all shader permutations in parallel and writes the header. The file is only touched if its content changes
+    to avoid needless rebuilds.
+    """
+    glslc = findGlslc()
+    for shaderFile, shaderType, shaderDefines in shaders:
+        print(f"Embedding {shaderType} shader: {shaderFile} [{shaderDefines}]")
+    with ThreadPoolExecutor() as executor:
+        codes = list(executor.map(lambda shader: compileShader(glslc, *shader, reduceCodeSize), shaders))
+
+    arrays = ""
+    entries = ""
+    for index, ((shaderFile, shaderType, shaderDefines), code) in enumerate(zip(shaders, codes)):
+        arrayName = f"shader_{index}_{re.sub(r'[^A-Za-z0-9]', '_', os.path.basename(shaderFile))}"
+        words = ",".join(("\n\t\t" if i % 8 == 0 else " ") + f"0x{word:08x}" for i, word in enumerate(code))
+        arrays += f"\t// {shaderFile} [{shaderDefines}]\n\tinline constexpr uint32_t {arrayName}[] = {{{words}\n\t}};\n\n"
+        entries += f'\t\t{{ "{shaderFile}", "{shaderType}", "{shaderDefines}", {arrayName}, sizeof({arrayName}) / sizeof(uint32_t) }},\n'
+
+    headerContent = f'''// This header contains the SPIR-V code of all shader permutations listed in GraphicalVulkanEditorProjectVariables.h.
+// DO NOT TOUCH THIS FILE. It is generated by resources/shaders/embed_shaders.py as pre-build step of the VulkanProject.
+
+
+#pragma once
+
+namespace GVEEmbeddedShaders {{
+
+	struct EmbeddedShader {{
+		const char* shaderFile; // shader file as listed in the project header
+		const char* shaderType; // "vertex" or "fragment"
+		const char* shaderDefines; // preprocessor defines of the permutation as listed in the project header
+		const uint32_t* code;
+		size_t wordCount;
+	}};
+
+{arrays}	inline constexpr EmbeddedShader SHADERS[] = {{
+{entries}	}};
+
+}}
+'''
+
+    if os.path.isfile(outputLocation):
+        with open(outputLocation, "r") as existingFile:
+            if existingFile.read() == headerContent:
+                return
+    with open(outputLocation, "w") as outputFile:
+        outputFile.write(headerContent)
+
+
+def main():
+    projectHeaderLocation = sys.argv[1] if len(sys.argv) > 1 else PROJECT_HEADER_LOCATION
+    outputLocation = os.path.abspath(sys.argv[2] if len(sys.argv) > 2 else EMBEDDED_SHADERS_OUTPUT_LOCATION)
+
+    with open(projectHeaderLocation, "r") as projectHeader:
+        headerContent = projectHeader.read()
+    reduceCodeSize = re.search(r"REDUCE_SPIRV_CODE_SIZE\s*=\s*(VK_TRUE|true)", headerContent) is not None
+
+    # shader paths in the project header are relative to the project directory
+    os.chdir(os.path.dirname(os.path.abspath(projectHeaderLocation)))
+
+    writeEmbeddedShadersHeader(readProjectShaders(headerContent), reduceCodeSize, outputLocation)
+
+
+if __name__ == '__main__':
+    main()
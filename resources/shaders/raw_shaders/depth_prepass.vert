@@ -0,0 +1,39 @@
+#version 450
+
+// Depth pre-pass: reads only the tightly packed vertex positions and has no outputs besides the position. The object data
+// is selected like in shader.vert.
+
+// set by the application: read the object data from push constants instead of the uniform buffer
+layout(constant_id = 0) const bool USE_PUSH_CONSTANTS = false;
+// set by the application: read the object data from the instance buffer, takes precedence over USE_PUSH_CONSTANTS
+layout(constant_id = 1) const bool USE_INSTANCING = false;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// per-object data, selected by the dynamic offset of each draw
+layout(binding = 2) uniform ObjectUniformData {
+    mat4 model;
+    vec4 materialColor;
+} object;
+
+// per-object data, pushed before each draw
+layout(push_constant) uniform ObjectPushConstants {
+    mat4 model;
+    vec4 materialColor;
+} objectPush;
+
+layout(location = 0) in vec3 inPosition;
+
+// per-instance data from vertex binding 1, the model matrix occupies locations 3 to 6
+layout(location = 3) in mat4 instanceModel;
+
+// must match gl_Position of shader.vert bit for bit, the scene subpass tests for equal depth
+invariant gl_Position;
+
+void main() {
+    mat4 model = USE_INSTANCING ? instanceModel : (USE_PUSH_CONSTANTS ? objectPush.model : object.model);
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+}
@@ -1,14 +1,24 @@
 #version 450
 
+// Permutations are selected by the shader defines of a pipeline:
+// DEBUG_UV     print texture coords for debugging
+// UNTEXTURED   use the vertex color only, without sampling the texture
+
 layout(binding = 1) uniform sampler2D texSampler; //access images through sampler unioform aka combined image sampler
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec4 fragMaterialColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
+#if defined(DEBUG_UV)
+    outColor = vec4(fragTexCoord, 0.0, 1.0); //print texture coords for debugging
+#elif defined(UNTEXTURED)
+    outColor = vec4(fragColor, 1.0) * fragMaterialColor;
+#else
     //outColor = vec4(fragColor * texture(texSampler, fragTexCoord).rgb, 1.0);
-    outColor = texture(texSampler, fragTexCoord /* *4 */); // Textures are sampled using the built-in texture function. It takes a sampler and coordinate as arguments. 
-    //outColor = vec4(fragTexCoord, 0.0, 1.0); //print texture coords for debugging
+    outColor = texture(texSampler, fragTexCoord /* *4 */) * fragMaterialColor; // Textures are sampled using the built-in texture function. It takes a sampler and coordinate as arguments. 
+#endif
 }
\ No newline at end of file
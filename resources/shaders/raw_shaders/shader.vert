@@ -1,20 +1,46 @@
 #version 450
 
+// set by the application: read the object data from push constants instead of the uniform buffer
+layout(constant_id = 0) const bool USE_PUSH_CONSTANTS = false;
+// set by the application: read the object data from the instance buffer, takes precedence over USE_PUSH_CONSTANTS
+layout(constant_id = 1) const bool USE_INSTANCING = false;
+
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
+// per-object data, selected by the dynamic offset of each draw
+layout(binding = 2) uniform ObjectUniformData {
+    mat4 model;
+    vec4 materialColor;
+} object;
+
+// per-object data, pushed before each draw
+layout(push_constant) uniform ObjectPushConstants {
+    mat4 model;
+    vec4 materialColor;
+} objectPush;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// per-instance data from vertex binding 1, the model matrix occupies locations 3 to 6
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in vec4 instanceMaterialColor;
+
+// computed exactly like in depth_prepass.vert, the scene subpass of the depth pre-pass tests for equal depth
+invariant gl_Position;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragMaterialColor;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    mat4 model = USE_INSTANCING ? instanceModel : (USE_PUSH_CONSTANTS ? objectPush.model : object.model);
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+    fragMaterialColor = USE_INSTANCING ? instanceMaterialColor : (USE_PUSH_CONSTANTS ? objectPush.materialColor : object.materialColor);
 }
\ No newline at end of file